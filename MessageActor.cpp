@@ -0,0 +1,106 @@
+#include "MessageActor.h"
+#include <QThread>
+#include <QThreadPool>
+
+namespace {
+// 单次调度最多执行的任务数，超过后重新排队，避免长邮箱独占工作线程
+constexpr int kDrainBatch = 64;
+}
+
+MessageMailbox::~MessageMailbox() {
+    while (head) {
+        Task* next = head->next;
+        delete head;
+        head = next;
+    }
+}
+
+bool MessageMailbox::post(std::function<void()> task) {
+    auto* node = new Task{std::move(task)};
+    bool schedule = false;
+    {
+        QMutexLocker locker(&mutex);
+        if (closed.load(std::memory_order_relaxed)) {
+            locker.unlock();
+            delete node;
+            return false;
+        }
+        if (tail) {
+            tail->next = node;
+        } else {
+            head = node;
+        }
+        tail = node;
+        if (!scheduled) {
+            scheduled = true;
+            active.fetch_add(1, std::memory_order_relaxed);
+            schedule = true;
+        }
+    }
+    if (schedule) {
+        auto self = shared_from_this();
+        Messenger::WorkerPool()->start([self] { self->drain(); });
+    }
+    return true;
+}
+
+void MessageMailbox::close() {
+    Task* pending = nullptr;
+    {
+        QMutexLocker locker(&mutex);
+        closed.store(true, std::memory_order_release);
+        pending = head;
+        head = tail = nullptr;
+    }
+    while (pending) {
+        Task* next = pending->next;
+        delete pending;
+        pending = next;
+    }
+    // 等待已提交的排空任务看到空邮箱后退出
+    while (active.load(std::memory_order_acquire) != 0) {
+        QThread::yieldCurrentThread();
+    }
+}
+
+void MessageMailbox::drain() {
+    for (int n = 0; n < kDrainBatch; ++n) {
+        Task* node = nullptr;
+        {
+            QMutexLocker locker(&mutex);
+            node = head;
+            if (!node) {
+                // 在锁内清除标记：post 看到 false 时必然会重新调度
+                scheduled = false;
+            } else {
+                head = node->next;
+                if (!head) tail = nullptr;
+            }
+        }
+        if (!node) {
+            // 解锁之后才发布空闲：这是本次排空对邮箱的最后一次访问
+            active.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        node->fn();
+        delete node;
+    }
+    auto self = shared_from_this();
+    Messenger::WorkerPool()->start([self] { self->drain(); });
+}
+
+MessageActor::MessageActor() : mailbox(std::make_shared<MessageMailbox>()) {}
+
+MessageActor::~MessageActor() {
+    close();
+}
+
+void MessageActor::post(std::function<void()> task) {
+    mailbox->post(std::move(task));
+}
+
+void MessageActor::close() {
+    // 先注销：之后的 Send 不再匹配本 Actor；仍持有旧快照的发送方由已关闭的邮箱丢弃
+    Messenger::Default().Unregister(this);
+    mailbox->close();
+}
@@ -0,0 +1,87 @@
+// MessageActor.h
+#pragma once
+#include <QMutex>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "Messenger.h"
+
+// ──────────────────────────────────────────────────────────────
+// Actor 邮箱：投递进来的任务按 FIFO 顺序、互不并发地在 Messenger::WorkerPool() 中执行。
+//
+// 邮箱与 Actor 对象分离、由 shared_ptr 共享：订阅持有邮箱，
+// Actor 关闭后，仍持有旧订阅快照的发送方投递只会被邮箱丢弃，不会触及已析构的 Actor。
+// ──────────────────────────────────────────────────────────────
+class MESSAGING_API MessageMailbox : public std::enable_shared_from_this<MessageMailbox> {
+public:
+    MessageMailbox() = default;
+    ~MessageMailbox();
+
+    // 投递任务；可从任意线程调用。邮箱已关闭时丢弃任务并返回 false
+    bool post(std::function<void()> task);
+
+    // 关闭邮箱：丢弃未执行的任务，等待执行中的排空结束；可重复调用
+    void close();
+
+    // 当前是否没有待执行或执行中的任务
+    bool isIdle() const { return active.load(std::memory_order_acquire) == 0; }
+    bool isClosed() const { return closed.load(std::memory_order_acquire); }
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        Task* next = nullptr;
+    };
+
+    void drain();
+
+    QMutex mutex;
+    Task* head = nullptr;
+    Task* tail = nullptr;
+    bool scheduled = false;             // 已提交排空任务（受 mutex 保护）
+    std::atomic<bool> closed{false};
+    std::atomic<int> active{0};         // 已提交且尚未结束的排空任务数；排空任务对邮箱的最后一次访问
+
+    Q_DISABLE_COPY_MOVE(MessageMailbox)
+};
+
+// ──────────────────────────────────────────────────────────────
+// 轻量 Actor（非 QObject 接收者）
+//
+// 每个 Actor 只有一个邮箱（MessageMailbox），执行时机由总线工作线程池调度，不绑定固定线程。
+// 对象本身只包含指向邮箱的 shared_ptr，适合大量细粒度接收者。
+//
+// 订阅与普通接收者使用同一套 Register / Unregister：
+//     class Counter : public MessageActor {
+//     public:
+//         ~Counter() override { close(); }
+//         void onMessage(const MyMessage& msg);
+//     };
+//     bus.Register<MyMessage>(&counter, &Counter::onMessage);
+//
+// 派生类必须在自己的析构函数中调用 close()：此时派生成员仍然有效，
+// 已排队的任务要么被丢弃，要么在 close() 返回前执行完毕。
+// 基类析构函数也会调用 close() 兜底，但那时派生部分已经析构，正在执行的回调可能访问失效成员。
+// 不要在 Actor 自己的回调中调用 close() 或析构它（会等待自身结束）。
+// ──────────────────────────────────────────────────────────────
+class MESSAGING_API MessageActor {
+public:
+    MessageActor();
+    virtual ~MessageActor();
+
+    // 投递任务到邮箱；可从任意线程调用
+    void post(std::function<void()> task);
+
+    // 注销全部订阅并关闭邮箱：丢弃未执行的任务，等待执行中的任务结束；可重复调用
+    void close();
+
+    // 当前是否没有待执行或执行中的任务
+    bool isIdle() const { return mailbox->isIdle(); }
+    bool isClosed() const { return mailbox->isClosed(); }
+
+private:
+    friend class Messenger;
+    std::shared_ptr<MessageMailbox> mailbox;
+
+    Q_DISABLE_COPY_MOVE(MessageActor)
+};
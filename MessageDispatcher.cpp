@@ -0,0 +1,261 @@
+#include "MessageDispatcher.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutexLocker>
+
+namespace {
+std::atomic<int> batchLimit{BatchingOptions().maxBatch};
+std::atomic<int> drainBudgetUs{BatchingOptions().maxDrainUs};
+
+// 当前线程正在以取消模式执行任务（见 MessageDispatcher::Cancelling）
+thread_local bool cancelling = false;
+
+void runCancelled(std::function<void()>& task) {
+    const bool outer = cancelling;
+    cancelling = true;
+    task();
+    cancelling = outer;
+}
+
+// 线程 -> 分发器；写时复制，投递方无锁读取
+using DispatcherTable = QHash<QThread*, std::shared_ptr<MessageDispatcher>>;
+
+struct Registry {
+    QMutex mutex;
+    std::shared_ptr<const DispatcherTable> table = std::make_shared<const DispatcherTable>();
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+void removeDispatcher(QThread* thread) {
+    Registry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    if (!r.table->contains(thread)) return;
+    auto next = std::make_shared<DispatcherTable>(*r.table);
+    next->remove(thread);
+    std::atomic_store(&r.table, std::shared_ptr<const DispatcherTable>(std::move(next)));
+}
+}
+
+// 位于目标线程的唤醒接收对象：收到总线唤醒事件时排空分发器
+class MessageDispatcher::Context : public QObject {
+public:
+    explicit Context(std::weak_ptr<MessageDispatcher> owner) : owner(std::move(owner)) {}
+
+    bool event(QEvent* e) override {
+        if (e->type() != MessageDispatcher::WakeupEventType()) return QObject::event(e);
+        if (auto dispatcher = owner.lock()) dispatcher->drain();
+        return true;
+    }
+
+private:
+    std::weak_ptr<MessageDispatcher> owner;
+};
+
+std::shared_ptr<MessageDispatcher> MessageDispatcher::ForThread(QThread* thread) {
+    if (!thread) return nullptr;
+    Registry& r = registry();
+    if (auto existing = std::atomic_load(&r.table)->value(thread)) return existing;
+
+    QMutexLocker locker(&r.mutex);
+    if (auto existing = r.table->value(thread)) return existing;
+    // 已结束的线程不会再发出 finished，新建的条目与唤醒对象将永远无法移除
+    if (thread->isFinished()) return nullptr;
+    std::shared_ptr<MessageDispatcher> dispatcher(new MessageDispatcher(thread));
+    auto* context = new Context(dispatcher);
+    context->moveToThread(thread);
+    dispatcher->context = context;
+    auto next = std::make_shared<DispatcherTable>(*r.table);
+    next->insert(thread, dispatcher);
+    std::atomic_store(&r.table, std::shared_ptr<const DispatcherTable>(std::move(next)));
+
+    // 线程结束：移除分发器、取消仍在队列中的任务，并在该线程中释放唤醒对象
+    QObject::connect(thread, &QThread::finished, context, [thread, owner = std::weak_ptr<MessageDispatcher>(dispatcher)] {
+        removeDispatcher(thread);
+        if (auto self = owner.lock()) self->cancel();
+    }, Qt::DirectConnection);
+    QObject::connect(thread, &QThread::finished, context, &QObject::deleteLater);
+    locker.unlock();
+
+    // 检查与连接之间线程恰好结束：撤销本次创建（线程已无事件循环，可直接释放唤醒对象）
+    if (thread->isFinished()) {
+        removeDispatcher(thread);
+        delete context;
+        return nullptr;
+    }
+    return dispatcher;
+}
+
+QList<DispatchStats> MessageDispatcher::AllStats() {
+    QList<DispatchStats> result;
+    const auto table = std::atomic_load(&registry().table);
+    for (const auto& dispatcher : *table) result.append(dispatcher->stats());
+    return result;
+}
+
+void MessageDispatcher::SetBatchingOptions(const BatchingOptions& options) {
+    batchLimit.store(qMax(1, options.maxBatch), std::memory_order_relaxed);
+    drainBudgetUs.store(qMax(0, options.maxDrainUs), std::memory_order_relaxed);
+}
+
+BatchingOptions MessageDispatcher::Batching() {
+    BatchingOptions options;
+    options.maxBatch = batchLimit.load(std::memory_order_relaxed);
+    options.maxDrainUs = drainBudgetUs.load(std::memory_order_relaxed);
+    return options;
+}
+
+QEvent::Type MessageDispatcher::WakeupEventType() {
+    static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+    return type;
+}
+
+MessageDispatcher::MessageDispatcher(QThread* thread)
+    : target(thread) {
+}
+
+MessageDispatcher::~MessageDispatcher() {
+    cancel();
+}
+
+bool MessageDispatcher::Cancelling() {
+    return cancelling;
+}
+
+void MessageDispatcher::RunCancelled(std::function<void()> task) {
+    runCancelled(task);
+}
+
+void MessageDispatcher::cancel() {
+    std::deque<std::function<void()>> dropped[LaneCount];
+    {
+        QMutexLocker locker(&mutex);
+        closed = true;
+        wakeupLevel = -1;
+        for (int level = 0; level < LaneCount; ++level) dropped[level].swap(lanes[level]);
+    }
+    for (auto& lane : dropped) {
+        for (auto& task : lane) runCancelled(task);
+    }
+}
+
+void MessageDispatcher::post(std::function<void()> task, MessagePriority priority) {
+    const int level = static_cast<int>(priority);
+    bool wake = false;
+    {
+        QMutexLocker locker(&mutex);
+        if (closed) {
+            locker.unlock();
+            runCancelled(task);
+            return;
+        }
+        lanes[level].push_back(std::move(task));
+        // 已有同级或更高优先级的唤醒在途时并入其中
+        if (level > wakeupLevel) {
+            wakeupLevel = level;
+            wake = true;
+        }
+    }
+    if (wake) scheduleWakeup(level);
+}
+
+void MessageDispatcher::post(std::vector<std::function<void()>>&& tasks, MessagePriority priority) {
+    if (tasks.empty()) return;
+    const int level = static_cast<int>(priority);
+    bool wake = false;
+    {
+        QMutexLocker locker(&mutex);
+        if (closed) {
+            locker.unlock();
+            for (auto& task : tasks) runCancelled(task);
+            tasks.clear();
+            return;
+        }
+        auto& lane = lanes[level];
+        for (auto& task : tasks) lane.push_back(std::move(task));
+        if (level > wakeupLevel) {
+            wakeupLevel = level;
+            wake = true;
+        }
+    }
+    tasks.clear();
+    if (wake) scheduleWakeup(level);
+}
+
+void MessageDispatcher::scheduleWakeup(int level) {
+    QObject* receiver = context.data();
+    if (!receiver) return;  // 目标线程已结束
+    static const int eventPriority[LaneCount] = {Qt::LowEventPriority, Qt::NormalEventPriority, Qt::HighEventPriority};
+    QCoreApplication::postEvent(receiver, new QEvent(WakeupEventType()), eventPriority[level]);
+}
+
+int MessageDispatcher::highestLane() const {
+    for (int level = LaneCount - 1; level >= 0; --level) {
+        if (!lanes[level].empty()) return level;
+    }
+    return -1;
+}
+
+void MessageDispatcher::drain() {
+    const int limit = batchLimit.load(std::memory_order_relaxed);
+    const qint64 budgetNs = qint64(drainBudgetUs.load(std::memory_order_relaxed)) * 1000;
+    QElapsedTimer clock;
+    clock.start();
+
+    quint64 batch = 0;
+    int yieldLevel = -1;
+    for (;;) {
+        std::function<void()> task;
+        {
+            QMutexLocker locker(&mutex);
+            const int level = highestLane();
+            if (level < 0) {
+                // 在锁内清除标记：post 看到 -1 时必然会重新唤醒
+                wakeupLevel = -1;
+                break;
+            }
+            if (batch >= quint64(limit) || (batch > 0 && clock.nsecsElapsed() >= budgetNs)) {
+                // 超出上限：让出事件循环，按剩余任务的最高优先级重新唤醒
+                wakeupLevel = level;
+                yieldLevel = level;
+                break;
+            }
+            task = std::move(lanes[level].front());
+            lanes[level].pop_front();
+        }
+        task();
+        ++batch;
+    }
+
+    if (batch > 0) {
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+        deliveries.fetch_add(batch, std::memory_order_relaxed);
+        quint64 seen = maxBatch.load(std::memory_order_relaxed);
+        while (batch > seen && !maxBatch.compare_exchange_weak(seen, batch, std::memory_order_relaxed)) {}
+        int bucket = 0;
+        while (bucket < DispatchStats::BucketCount && batch > quint64(DispatchStats::BatchBounds[bucket])) ++bucket;
+        batchBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (yieldLevel >= 0) scheduleWakeup(yieldLevel);
+}
+
+DispatchStats MessageDispatcher::stats() const {
+    DispatchStats s;
+    s.thread = target->objectName().isEmpty()
+        ? QString("0x%1").arg(quintptr(target), 0, 16)
+        : target->objectName();
+    s.wakeups = wakeups.load(std::memory_order_relaxed);
+    s.deliveries = deliveries.load(std::memory_order_relaxed);
+    s.maxBatch = maxBatch.load(std::memory_order_relaxed);
+    for (int i = 0; i <= DispatchStats::BucketCount; ++i) {
+        s.batchBuckets[i] = batchBuckets[i].load(std::memory_order_relaxed);
+    }
+    QMutexLocker locker(&mutex);
+    for (const auto& lane : lanes) s.pending += quint64(lane.size());
+    return s;
+}
@@ -0,0 +1,104 @@
+// MessageDispatcher.h
+#pragma once
+#include <QEvent>
+#include <QMutex>
+#include <QPointer>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Messenger.h"
+
+// ──────────────────────────────────────────────────────────────
+// 线程分发器：跨线程投递的自适应批处理
+//
+// 每个目标线程一个分发器（首次投递时创建，线程结束时移除，剩余任务以取消模式执行）。
+// 投递进入分发器队列；只有队列没有待处理唤醒时才向目标线程投递一次唤醒，
+// 唤醒到来之前到达的投递全部并入同一次排空（类似 Nagle）：
+// 低负载时每条消息一次唤醒、立即执行；高负载时一次唤醒处理一批，
+// 每条消息分摊的事件循环开销随吞吐上升自动下降。
+//
+// 单次排空受 BatchingOptions 约束（条数与耗时上限），超出后让出事件循环
+// 并重新唤醒，避免长队列推迟目标线程的其他事件。
+//
+// 唤醒使用总线自己注册的 QEvent 类型（WakeupEventType()），由位于目标线程的
+// 分发对象在 event() 中排空总线队列：每次唤醒一个事件，投递本身不产生
+// QMetaCallEvent。队列按 MessagePriority 分为三条通道，排空时高优先级先行、
+// 同一通道内保持 FIFO；唤醒事件以对应的 Qt 事件优先级投递，更高优先级的
+// 投递到达时会补发一次更高优先级的唤醒。
+// ──────────────────────────────────────────────────────────────
+struct BatchingOptions {
+    int maxBatch = 256;    // 单次排空最多执行的投递数
+    int maxDrainUs = 2000; // 单次排空最长耗时（微秒）
+};
+
+// 单个线程分发器的统计
+struct DispatchStats {
+    static constexpr int BucketCount = 5;
+    static constexpr int BatchBounds[BucketCount] = {1, 4, 16, 64, 256};  // 批大小上界
+
+    QString thread;
+    quint64 wakeups = 0;     // 排空次数（不含空唤醒）
+    quint64 deliveries = 0;  // 执行的投递数
+    quint64 maxBatch = 0;
+    quint64 pending = 0;     // 当前排队数
+    quint64 batchBuckets[BucketCount + 1] = {};  // 批大小分布（非累积，最后一桶为 +Inf）
+};
+
+class MESSAGING_API MessageDispatcher : public std::enable_shared_from_this<MessageDispatcher> {
+public:
+    // 目标线程的分发器（不存在时创建）；线程已结束时返回 nullptr
+    static std::shared_ptr<MessageDispatcher> ForThread(QThread* thread);
+    // 全部分发器的统计
+    static QList<DispatchStats> AllStats();
+
+    static void SetBatchingOptions(const BatchingOptions& options);
+    static BatchingOptions Batching();
+
+    // 唤醒事件类型（进程内首次使用时向 Qt 注册）
+    static QEvent::Type WakeupEventType();
+
+    // 目标线程结束时仍在队列中的任务（以及之后才投递的任务）不会被丢弃，而是以取消模式执行一次：
+    // 执行期间 Cancelling() 为 true，任务只应归还占用的资源（流控额度、计数等），不做投递
+    static bool Cancelling();
+    // 以取消模式执行任务（无法投递到目标线程时由调用方使用）
+    static void RunCancelled(std::function<void()> task);
+
+    ~MessageDispatcher();
+
+    // 投递任务到目标线程；可从任意线程调用
+    void post(std::function<void()> task, MessagePriority priority = MessagePriority::Normal);
+    // 一次投递多条任务：只加一次锁、至多唤醒一次，任务在同一通道内保持给定顺序
+    void post(std::vector<std::function<void()>>&& tasks, MessagePriority priority = MessagePriority::Normal);
+
+    QThread* thread() const { return target; }
+    DispatchStats stats() const;
+
+private:
+    class Context;
+    static constexpr int LaneCount = 3;
+
+    explicit MessageDispatcher(QThread* thread);
+    void scheduleWakeup(int level);
+    void drain();
+    void cancel();            // 关闭并以取消模式执行剩余任务
+    int highestLane() const;  // 需持有 mutex；没有任务时返回 -1
+
+    QThread* target;
+    QPointer<QObject> context;  // 位于目标线程，接收唤醒事件；随线程结束释放
+
+    mutable QMutex mutex;
+    std::deque<std::function<void()>> lanes[LaneCount];  // 下标即 MessagePriority
+    int wakeupLevel = -1;  // 已投递未处理的唤醒中最高的优先级，-1 表示没有（受 mutex 保护）
+    bool closed = false;   // 目标线程已结束（受 mutex 保护）
+
+    std::atomic<quint64> wakeups{0};
+    std::atomic<quint64> deliveries{0};
+    std::atomic<quint64> maxBatch{0};
+    std::atomic<quint64> batchBuckets[DispatchStats::BucketCount + 1] = {};
+
+    Q_DISABLE_COPY_MOVE(MessageDispatcher)
+};
@@ -0,0 +1,74 @@
+#include "MessageExecutor.h"
+#include "MessageDispatcher.h"
+#include <QThread>
+#include <QThreadPool>
+
+namespace {
+
+class InlineExecutor final : public MessageExecutor {
+public:
+    void execute(std::function<void()> task) override { task(); }
+};
+
+class PoolExecutor final : public MessageExecutor {
+public:
+    explicit PoolExecutor(QThreadPool* pool) : pool(pool) {}
+    void execute(std::function<void()> task) override { pool->start(std::move(task)); }
+private:
+    QThreadPool* pool;
+};
+
+// 经目标线程的分发器排队：与跨线程投递一起合批唤醒，不再逐条产生元调用事件
+class ThreadExecutor final : public MessageExecutor {
+public:
+    explicit ThreadExecutor(QThread* thread) : thread(thread) {}
+    void execute(std::function<void()> task) override {
+        executeWithPriority(std::move(task), MessagePriority::Normal);
+    }
+    void executeWithPriority(std::function<void()> task, MessagePriority priority) override {
+        if (QThread::currentThread() == thread) {
+            task();
+            return;
+        }
+        if (const auto dispatcher = MessageDispatcher::ForThread(thread)) {
+            dispatcher->post(std::move(task), priority);
+        } else {
+            // 目标线程已结束：以取消模式执行，任务只归还占用的资源
+            MessageDispatcher::RunCancelled(std::move(task));
+        }
+    }
+private:
+    QThread* thread;
+};
+
+class FunctionExecutor final : public MessageExecutor {
+public:
+    explicit FunctionExecutor(std::function<void(std::function<void()>)> dispatch) : dispatch(std::move(dispatch)) {}
+    void execute(std::function<void()> task) override { dispatch(std::move(task)); }
+private:
+    std::function<void(std::function<void()>)> dispatch;
+};
+
+}
+
+void MessageExecutor::executeWithPriority(std::function<void()> task, MessagePriority priority) {
+    Q_UNUSED(priority)
+    execute(std::move(task));
+}
+
+std::shared_ptr<MessageExecutor> MessageExecutor::Inline() {
+    static const std::shared_ptr<MessageExecutor> instance = std::make_shared<InlineExecutor>();
+    return instance;
+}
+
+std::shared_ptr<MessageExecutor> MessageExecutor::Pool(QThreadPool* pool) {
+    return std::make_shared<PoolExecutor>(pool ? pool : Messenger::WorkerPool());
+}
+
+std::shared_ptr<MessageExecutor> MessageExecutor::Thread(QThread* thread) {
+    return std::make_shared<ThreadExecutor>(thread ? thread : QThread::currentThread());
+}
+
+std::shared_ptr<MessageExecutor> MessageExecutor::Wrap(std::function<void(std::function<void()>)> dispatch) {
+    return std::make_shared<FunctionExecutor>(std::move(dispatch));
+}
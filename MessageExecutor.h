@@ -0,0 +1,32 @@
+// MessageExecutor.h
+#pragma once
+#include <functional>
+#include <memory>
+#include "Messenger.h"
+
+// ──────────────────────────────────────────────────────────────
+// 投递目标执行器
+//
+// Register 可以指定执行器来决定回调在哪里运行，而不是默认的“接收者所在线程”。
+// 接口只有一个 execute()：实现者负责把任务交给自己的线程 / 线程池 / 串行队列。
+//
+// 内置：
+// - Inline()        在发送线程中立即执行
+// - Pool(pool)      提交到 QThreadPool（默认为 Messenger::WorkerPool()）
+// - Thread(thread)  排队到指定 QThread 的线程分发器（与跨线程投递共享合批唤醒与优先级通道）；
+//                   已在该线程时直接执行
+// - Wrap(fn)        用任意函数适配已有的调度设施
+// ──────────────────────────────────────────────────────────────
+class MESSAGING_API MessageExecutor {
+public:
+    virtual ~MessageExecutor() = default;
+
+    virtual void execute(std::function<void()> task) = 0;
+    // 带投递优先级的执行：默认忽略优先级，排队到线程分发器的执行器按优先级通道处理
+    virtual void executeWithPriority(std::function<void()> task, MessagePriority priority);
+
+    static std::shared_ptr<MessageExecutor> Inline();
+    static std::shared_ptr<MessageExecutor> Pool(QThreadPool* pool = nullptr);
+    static std::shared_ptr<MessageExecutor> Thread(QThread* thread);
+    static std::shared_ptr<MessageExecutor> Wrap(std::function<void(std::function<void()>)> dispatch);
+};
@@ -0,0 +1,163 @@
+// MessageJoin.h
+#pragma once
+#include <QObject>
+#include <QHash>
+#include <QElapsedTimer>
+#include <deque>
+#include <functional>
+#include "Messenger.h"
+
+// ──────────────────────────────────────────────────────────────
+// 双类型按键关联（join / zip）
+//
+// 分别订阅 TLeft 与 TRight，按提取出的键缓存未匹配的一侧；
+// 另一侧同键消息到达时立即组合投递并移除缓存。
+// 每侧缓存受容量上限约束，超出时淘汰最旧条目；
+// 超过 TTL 仍未匹配的条目在后续到达时惰性淘汰，也可手动 EvictExpired()。
+//
+// 回调在 MessageJoin 所属线程执行（与普通 QObject 接收者一致），
+// 缓存只在该线程访问，因此无需加锁。
+// ──────────────────────────────────────────────────────────────
+
+struct JoinOptions {
+    int capacity = 1024;  // 每侧最多缓存的未匹配条目数
+    int ttlMs = 5000;     // 未匹配条目存活时间（<= 0 表示不过期）
+};
+
+template<typename TLeft, typename TRight>
+struct JoinedMessage {
+    TLeft left;
+    TRight right;
+};
+
+template<typename TLeft, typename TRight, typename TKey>
+class MessageJoin : public QObject {
+public:
+    using LeftKey = std::function<TKey(const TLeft&)>;
+    using RightKey = std::function<TKey(const TRight&)>;
+    using Handler = std::function<void(const JoinedMessage<TLeft, TRight>&)>;
+
+    MessageJoin(LeftKey leftKey, RightKey rightKey, Handler onJoined,
+                const JoinOptions& options = JoinOptions(),
+                const MessageToken& token = MessageToken(),
+                QObject* parent = nullptr)
+        : QObject(parent)
+        , leftKey(std::move(leftKey))
+        , rightKey(std::move(rightKey))
+        , onJoined(std::move(onJoined))
+        , options(options) {
+        clock.start();
+        Messenger::Default().Register<TLeft>(this, [this](const TLeft& msg) { onLeft(msg); }, token);
+        Messenger::Default().Register<TRight>(this, [this](const TRight& msg) { onRight(msg); }, token);
+    }
+
+    ~MessageJoin() override {
+        Messenger::Default().Unregister(this);
+    }
+
+    int pendingLeft() const { return left.entries.size(); }
+    int pendingRight() const { return right.entries.size(); }
+    quint64 evictedCount() const { return evicted; }
+
+    // 淘汰两侧所有已过期条目
+    void EvictExpired() {
+        const qint64 now = clock.elapsed();
+        left.evictExpired(now, options.ttlMs, evicted);
+        right.evictExpired(now, options.ttlMs, evicted);
+    }
+
+private:
+    template<typename T>
+    struct Side {
+        struct Entry {
+            T message;
+            qint64 arrivedMs;
+            quint64 seq;
+        };
+        QHash<TKey, Entry> entries;
+        std::deque<std::pair<TKey, quint64>> order;  // 到达顺序；可能含已匹配/已替换的陈旧记录
+
+        bool isLive(const std::pair<TKey, quint64>& rec) const {
+            auto it = entries.constFind(rec.first);
+            return it != entries.constEnd() && it->seq == rec.second;
+        }
+
+        void evictExpired(qint64 now, int ttlMs, quint64& evicted) {
+            if (ttlMs <= 0) return;
+            while (!order.empty()) {
+                const auto& rec = order.front();
+                auto it = entries.find(rec.first);
+                if (it != entries.end() && it->seq == rec.second) {
+                    if (now - it->arrivedMs < ttlMs) break;
+                    entries.erase(it);
+                    ++evicted;
+                }
+                order.pop_front();
+            }
+        }
+
+        void evictOldest(quint64& evicted) {
+            while (!order.empty()) {
+                const auto rec = order.front();
+                order.pop_front();
+                if (isLive(rec)) {
+                    entries.remove(rec.first);
+                    ++evicted;
+                    return;
+                }
+            }
+        }
+
+        void store(const TKey& key, const T& message, qint64 now, quint64 seq, int capacity, quint64& evicted) {
+            if (!entries.contains(key)) {
+                while (capacity > 0 && entries.size() >= capacity) evictOldest(evicted);
+            }
+            entries.insert(key, Entry{message, now, seq});
+            order.emplace_back(key, seq);
+            // 陈旧记录过多时压缩，保证 order 与 entries 同量级
+            if (order.size() > static_cast<size_t>(2 * entries.size() + 64)) {
+                std::deque<std::pair<TKey, quint64>> live;
+                for (const auto& rec : order) {
+                    if (isLive(rec)) live.push_back(rec);
+                }
+                order.swap(live);
+            }
+        }
+    };
+
+    void onLeft(const TLeft& msg) {
+        const TKey key = leftKey(msg);
+        EvictExpired();
+        auto it = right.entries.find(key);
+        if (it != right.entries.end()) {
+            JoinedMessage<TLeft, TRight> joined{msg, std::move(it->message)};
+            right.entries.erase(it);
+            onJoined(joined);
+            return;
+        }
+        left.store(key, msg, clock.elapsed(), ++seq, options.capacity, evicted);
+    }
+
+    void onRight(const TRight& msg) {
+        const TKey key = rightKey(msg);
+        EvictExpired();
+        auto it = left.entries.find(key);
+        if (it != left.entries.end()) {
+            JoinedMessage<TLeft, TRight> joined{std::move(it->message), msg};
+            left.entries.erase(it);
+            onJoined(joined);
+            return;
+        }
+        right.store(key, msg, clock.elapsed(), ++seq, options.capacity, evicted);
+    }
+
+    LeftKey leftKey;
+    RightKey rightKey;
+    Handler onJoined;
+    JoinOptions options;
+    QElapsedTimer clock;
+    quint64 seq = 0;
+    quint64 evicted = 0;
+    Side<TLeft> left;
+    Side<TRight> right;
+};
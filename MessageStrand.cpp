@@ -0,0 +1,62 @@
+#include "MessageStrand.h"
+
+namespace {
+// 单次调度最多执行的任务数，超过后重新提交，让出底层工作线程
+constexpr int kDrainBatch = 64;
+thread_local const MessageStrand* currentStrand = nullptr;
+
+struct CurrentStrandScope {
+    explicit CurrentStrandScope(const MessageStrand* strand) : previous(currentStrand) { currentStrand = strand; }
+    ~CurrentStrandScope() { currentStrand = previous; }
+    const MessageStrand* previous;
+};
+}
+
+std::shared_ptr<MessageStrand> MessageStrand::Create(std::shared_ptr<MessageExecutor> target) {
+    return std::shared_ptr<MessageStrand>(new MessageStrand(target ? std::move(target) : MessageExecutor::Pool()));
+}
+
+MessageStrand::MessageStrand(std::shared_ptr<MessageExecutor> target)
+    : target(std::move(target)) {}
+
+void MessageStrand::execute(std::function<void()> task) {
+    bool schedule = false;
+    {
+        QMutexLocker locker(&mutex);
+        queue.push_back(std::move(task));
+        if (!scheduled) {
+            scheduled = true;
+            schedule = true;
+        }
+    }
+    if (schedule) {
+        target->execute([self = shared_from_this()] { self->drain(); });
+    }
+}
+
+bool MessageStrand::runningInThisThread() const {
+    return currentStrand == this;
+}
+
+int MessageStrand::pending() const {
+    QMutexLocker locker(&mutex);
+    return static_cast<int>(queue.size());
+}
+
+void MessageStrand::drain() {
+    CurrentStrandScope scope(this);
+    for (int n = 0; n < kDrainBatch; ++n) {
+        std::function<void()> task;
+        {
+            QMutexLocker locker(&mutex);
+            if (queue.empty()) {
+                scheduled = false;
+                return;
+            }
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        task();
+    }
+    target->execute([self = shared_from_this()] { self->drain(); });
+}
@@ -0,0 +1,41 @@
+// MessageStrand.h
+#pragma once
+#include <QMutex>
+#include <deque>
+#include <memory>
+#include "MessageExecutor.h"
+
+// ──────────────────────────────────────────────────────────────
+// Strand：串行执行器
+//
+// 提交到同一 Strand 的任务按提交顺序执行，且任意时刻最多一个在运行；
+// 任务本身在底层执行器（默认总线工作线程池）上运行，不占用专属线程。
+// 把组件的所有订阅都注册到同一个 Strand，即可获得“单线程”语义：
+//     auto strand = MessageStrand::Create();
+//     bus.Register<MyMessage>(&component, &Component::onA, strand);
+//     bus.Register<AnotherMessage>(&component, &Component::onB, strand);
+//
+// 排空任务持有 Strand 的 shared_ptr，因此释放最后一个外部引用后
+// 已提交的任务仍会执行完毕。
+// ──────────────────────────────────────────────────────────────
+class MESSAGING_API MessageStrand : public MessageExecutor, public std::enable_shared_from_this<MessageStrand> {
+public:
+    static std::shared_ptr<MessageStrand> Create(std::shared_ptr<MessageExecutor> target = nullptr);
+
+    void execute(std::function<void()> task) override;
+
+    // 当前线程是否正在执行本 Strand 的任务
+    bool runningInThisThread() const;
+
+    // 待执行的任务数（不含正在执行的任务）
+    int pending() const;
+
+private:
+    explicit MessageStrand(std::shared_ptr<MessageExecutor> target);
+    void drain();
+
+    std::shared_ptr<MessageExecutor> target;
+    mutable QMutex mutex;
+    std::deque<std::function<void()>> queue;
+    bool scheduled = false;  // 已提交到底层执行器且尚未排空
+};
@@ -0,0 +1,126 @@
+#include "MessageTracer.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <algorithm>
+#include <functional>
+
+MessageTracer::MessageTracer(int capacity, Messenger& bus)
+    : bus(bus)
+    , capacity(qMax(1, capacity)) {
+}
+
+void MessageTracer::onSend(quint64 type, const MessageEnvelope& envelope) {
+    TraceRecord record;
+    record.sequence = envelope.sequence;
+    record.causationId = envelope.causationId;
+    record.type = type;
+    record.typeName = bus.TypeInfo(type).name;
+    record.timestampNs = envelope.timestampNs;
+
+    QMutexLocker locker(&mutex);
+    auto parent = envelope.causationId ? records.constFind(envelope.causationId) : records.constEnd();
+    if (parent != records.constEnd()) {
+        record.root = parent->root;
+        record.rootType = parent->rootType;
+        record.depth = parent->depth + 1;
+    } else {
+        record.root = record.sequence;
+        record.rootType = type;
+        totals[type].roots += 1;
+    }
+    Totals& t = totals[record.rootType];
+    t.messages += 1;
+    t.maxDepth = qMax(t.maxDepth, record.depth);
+
+    records.insert(record.sequence, record);
+    order.push_back(record.sequence);
+    while (static_cast<int>(order.size()) > capacity) {
+        const quint64 evicted = order.front();
+        order.pop_front();
+        records.remove(evicted);
+    }
+}
+
+void MessageTracer::onMatched(quint64 sequence, int matched) {
+    QMutexLocker locker(&mutex);
+    auto it = records.find(sequence);
+    if (it == records.end()) return;
+    it->matched = matched;
+    totals[it->rootType].deliveries += quint64(matched);
+}
+
+QList<TraceRecord> MessageTracer::Tree(quint64 rootSequence) const {
+    QList<TraceRecord> result;
+    {
+        QMutexLocker locker(&mutex);
+        for (const TraceRecord& record : records) {
+            if (record.root == rootSequence) result.append(record);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const TraceRecord& a, const TraceRecord& b) {
+        return a.sequence < b.sequence;
+    });
+    return result;
+}
+
+QByteArray MessageTracer::DumpTree(quint64 rootSequence, bool indented) const {
+    const QList<TraceRecord> tree = Tree(rootSequence);
+    QHash<quint64, QList<int>> children;  // 父 sequence -> 子记录下标
+    for (int i = 0; i < tree.size(); ++i) {
+        if (tree.at(i).sequence != rootSequence) children[tree.at(i).causationId].append(i);
+    }
+
+    std::function<QJsonObject(int)> build = [&](int index) {
+        const TraceRecord& record = tree.at(index);
+        QJsonObject node;
+        node["sequence"] = qint64(record.sequence);
+        node["type"] = QString::fromLatin1(record.typeName);
+        node["depth"] = record.depth;
+        node["matched"] = record.matched;
+        QJsonArray kids;
+        for (int child : children.value(record.sequence)) kids.append(build(child));
+        if (!kids.isEmpty()) node["children"] = kids;
+        return node;
+    };
+
+    QJsonObject root;
+    if (!tree.isEmpty() && tree.first().sequence == rootSequence) root = build(0);
+    return QJsonDocument(root).toJson(indented ? QJsonDocument::Indented : QJsonDocument::Compact);
+}
+
+QList<AmplificationStats> MessageTracer::Amplification() const {
+    QList<AmplificationStats> result;
+    {
+        QMutexLocker locker(&mutex);
+        for (auto it = totals.constBegin(); it != totals.constEnd(); ++it) {
+            if (it->roots == 0) continue;
+            AmplificationStats stats;
+            stats.rootType = bus.TypeInfo(it.key()).name;
+            stats.roots = it->roots;
+            stats.messages = it->messages;
+            stats.deliveries = it->deliveries;
+            stats.maxDepth = it->maxDepth;
+            stats.factor = double(it->messages) / double(it->roots);
+            result.append(stats);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const AmplificationStats& a, const AmplificationStats& b) {
+        return a.factor > b.factor;
+    });
+    return result;
+}
+
+quint64 MessageTracer::RootOf(quint64 sequence) const {
+    QMutexLocker locker(&mutex);
+    auto it = records.constFind(sequence);
+    return it != records.constEnd() ? it->root : 0;
+}
+
+void MessageTracer::Clear() {
+    QMutexLocker locker(&mutex);
+    records.clear();
+    order.clear();
+    totals.clear();
+}
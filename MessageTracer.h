@@ -0,0 +1,80 @@
+// MessageTracer.h
+#pragma once
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <deque>
+#include "Messenger.h"
+
+// ──────────────────────────────────────────────────────────────
+// 因果追踪
+//
+// 处理函数内发出的 Send 会自动以当前消息的 sequence 作为 causationId，
+// 并继承其 correlationId（见 Messenger::CurrentEnvelope）。追踪器记录
+// 每次发送的 (sequence, causationId, 类型, 匹配数)，据此还原以根消息为起点的
+// 扇出树，并按根消息类型统计放大系数（每个根消息平均引发的消息数）。
+//
+//     auto tracer = std::make_shared<MessageTracer>();
+//     bus.SetTracer(tracer);
+//     ...
+//     for (const auto& a : tracer->Amplification()) qDebug() << a.rootType << a.factor;
+//
+// 记录按 capacity 保留最近的消息；父消息已被淘汰的消息视为新的根。
+// 放大统计在记录时累计，不受淘汰影响。
+// ──────────────────────────────────────────────────────────────
+struct TraceRecord {
+    quint64 sequence = 0;
+    quint64 causationId = 0;   // 父消息 sequence（根为 0）
+    quint64 root = 0;          // 所在树的根消息 sequence
+    quint64 rootType = 0;      // 根消息类型
+    quint64 type = 0;
+    QByteArray typeName;
+    int depth = 0;             // 根为 0
+    int matched = 0;           // 匹配到的订阅数
+    qint64 timestampNs = 0;
+};
+
+struct AmplificationStats {
+    QByteArray rootType;
+    quint64 roots = 0;         // 以该类型为根的树数
+    quint64 messages = 0;      // 这些树中的消息总数（含根）
+    quint64 deliveries = 0;    // 这些树中的订阅匹配总数
+    int maxDepth = 0;
+    double factor = 0;         // messages / roots
+};
+
+class MESSAGING_API MessageTracer {
+public:
+    explicit MessageTracer(int capacity = 65536, Messenger& bus = Messenger::Default());
+
+    // 由 Messenger 调用：发送开始（派发前）与匹配结束
+    void onSend(quint64 type, const MessageEnvelope& envelope);
+    void onMatched(quint64 sequence, int matched);
+
+    // 根消息及其全部后代，按 sequence 排序
+    QList<TraceRecord> Tree(quint64 rootSequence) const;
+    // 扇出树的嵌套 JSON
+    QByteArray DumpTree(quint64 rootSequence, bool indented = true) const;
+    // 按根消息类型统计，放大系数降序
+    QList<AmplificationStats> Amplification() const;
+    // 消息所在树的根（未记录时返回 0）
+    quint64 RootOf(quint64 sequence) const;
+
+    void Clear();
+
+private:
+    struct Totals {
+        quint64 roots = 0;
+        quint64 messages = 0;
+        quint64 deliveries = 0;
+        int maxDepth = 0;
+    };
+
+    Messenger& bus;
+    const int capacity;
+    mutable QMutex mutex;
+    QHash<quint64, TraceRecord> records;
+    std::deque<quint64> order;           // 记录顺序，用于按容量淘汰
+    QHash<quint64, Totals> totals;       // 根类型 -> 累计
+};
@@ -1,44 +1,1160 @@
 #include "Messenger.h"
+#include "MessageActor.h"
+#include "MessageDispatcher.h"
+#include "MessageExecutor.h"
+#include "MessengerHooks.h"
+#include "MessageTracer.h"
+#include <QCoreApplication>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QVarLengthArray>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <chrono>
+#include <variant>
+#include <vector>
+
+namespace {
+qint64 monotonicNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 当前线程正在处理的消息：处理函数内的 Send 由此继承因果关系
+thread_local const MessageEnvelope* currentEnvelope = nullptr;
+
+// 发送返回后仍被持有、需要统一类型存放的载荷（暂存、合批条目）：
+// 二选一保存——内联小消息的字节（不分配），或与发送方共享的 QVariant（不额外占用内联缓冲区）
+class HeldPayload {
+public:
+    explicit HeldPayload(const QVariant& payload) {
+        if (const MessengerDetail::InlineBytes* bytes = MessengerDetail::inlineBytes(payload)) {
+            storage = *bytes;
+        } else {
+            storage = payload;
+        }
+    }
+
+    // 以载荷调用 f：内联字节在调用期间包装为指向自身的 QVariant（指针大小，不分配），
+    // 共享载荷按引用传入，不增加引用计数（右值处理函数独占时可以移动）
+    template<typename F>
+    decltype(auto) use(F&& f) const {
+        if (const auto* bytes = std::get_if<MessengerDetail::InlineBytes>(&storage)) {
+            const QVariant view = QVariant::fromValue(MessengerDetail::InlineMessage{bytes});
+            return f(view);
+        }
+        return f(std::get<QVariant>(storage));
+    }
+
+    // 交出载荷（共享载荷不增加引用计数）；内联字节仍归本对象，需在投递结束前保持存活
+    QVariant take() {
+        if (const auto* bytes = std::get_if<MessengerDetail::InlineBytes>(&storage)) {
+            return QVariant::fromValue(MessengerDetail::InlineMessage{bytes});
+        }
+        return std::move(std::get<QVariant>(storage));
+    }
+
+private:
+    std::variant<QVariant, MessengerDetail::InlineBytes> storage;
+};
+
+// 排队闭包持有的载荷：与发送方共享的 QVariant，或复制出的内联小消息字节。
+// 与 HeldPayload 相同的 use() 接口，但各自只占用所需的大小
+struct SharedHeld {
+    QVariant payload;
+
+    template<typename F>
+    decltype(auto) use(F&& f) const { return f(payload); }
+};
+
+struct InlineHeld {
+    MessengerDetail::InlineBytes bytes;
+
+    template<typename F>
+    decltype(auto) use(F&& f) const {
+        const QVariant view = QVariant::fromValue(MessengerDetail::InlineMessage{&bytes});
+        return f(view);
+    }
+};
+
+// 按载荷种类生成排队任务：只有内联小消息的闭包携带 InlineCapacity 字节的缓冲区，
+// 其余类型的闭包只多一个 QVariant。body 以 const 引用接收持有的载荷
+template<typename R = void, typename Body>
+std::function<R()> heldTask(const QVariant& payload, Body&& body) {
+    if (const MessengerDetail::InlineBytes* bytes = MessengerDetail::inlineBytes(payload)) {
+        return [body = std::forward<Body>(body), held = InlineHeld{*bytes}] { return body(held); };
+    }
+    return [body = std::forward<Body>(body), held = SharedHeld{payload}] { return body(held); };
+}
+
+// 暂存的一次发送：因果与时间戳在 Send 时确定
+struct StagedSend {
+    quint64 type = 0;
+    MessageToken token;
+    HeldPayload payload;
+    quint64 correlationId = 0;
+    qint64 timestampNs = 0;
+    bool caused = false;
+    MessageEnvelope cause;
+};
+
+QEvent::Type flushEventType() {
+    static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+    return type;
+}
+
+// 位于发送线程，收到刷新事件时发送暂存区
+class StagingFlusher : public QObject {
+public:
+    explicit StagingFlusher(Messenger* bus) : bus(bus) {}
+
+    bool event(QEvent* e) override {
+        if (e->type() != flushEventType()) return QObject::event(e);
+        flushScheduled = false;
+        bus->Flush();
+        return true;
+    }
+
+    Messenger* bus;
+    bool flushScheduled = false;
+};
+
+// 发送线程的暂存区
+struct StagingBuffer {
+    explicit StagingBuffer(Messenger* bus) : bus(bus) {}
+    ~StagingBuffer() { delete flusher; }
+
+    void stage(StagedSend&& entry) {
+        entries.push_back(std::move(entry));
+        if (!flusher) flusher = new StagingFlusher(bus);
+        if (flusher->flushScheduled) return;
+        flusher->flushScheduled = true;
+        // 低优先级：在本轮已排队的事件之后执行
+        QCoreApplication::postEvent(flusher, new QEvent(flushEventType()), Qt::LowEventPriority);
+    }
+
+    Messenger* bus;
+    StagingFlusher* flusher = nullptr;
+    std::vector<StagedSend> entries;
+};
+
+// 线程结束时发送剩余消息后释放暂存区
+struct StagingHolder {
+    ~StagingHolder() {
+        if (!buffer) return;
+        buffer->bus->Flush();
+        delete buffer;
+        buffer = nullptr;
+    }
+    StagingBuffer* buffer = nullptr;
+};
+
+thread_local bool stagingEnabled = false;
+thread_local StagingHolder staging;
+}
+
+// 批量处理函数的订阅内合批：排队投递先进入 items，只有 items 为空时才排队一个排空任务，
+// 排空任务一次取走全部条目并以 PayloadBatch 调用处理函数
+struct Messenger::DeliveryBatch {
+    struct Item {
+        HeldPayload payload;
+        MessageEnvelope envelope;
+        std::shared_ptr<FlowGate> gate;
+    };
+    QMutex mutex;
+    std::vector<Item> items;
+};
+
+// 一批发送共用的状态：订阅快照、最近一次匹配结果与按目标聚合的排队任务。
+// 组发布模式下，同一目标（分发器 / actor / 执行器）的全部投递合并为一个任务，
+// 保证接收者连续处理；流控额度由 Publish 预先为整组预留。
+struct Messenger::SendBatch {
+    using Matched = QVarLengthArray<SubscriptionPtr, 8>;
+    using Submit = std::function<void(std::function<void()>&&)>;
+
+    SendBatch(std::shared_ptr<const SubscriptionList> subs, bool grouped = false)
+        : subs(std::move(subs)), grouped(grouped) {}
+    ~SendBatch() { commit(); }
+
+    // 需要排队的投递：同线程 QObject 接收者与无执行器的 shared_ptr 接收者同步执行
+    static bool queued(const SubscriptionPtr& sub) {
+        if (sub->actor || sub->executor) return true;
+        if (sub->trackedKey) return false;
+        QObject* receiver = sub->receiver.data();
+        return receiver && receiver->thread() != QThread::currentThread();
+    }
+
+    // 连续同类型同 Token 的消息复用上一次的匹配结果
+    const Matched& match(quint64 type, const MessageToken& token) {
+        if (hasMatch && type == matchedType && token == matchedToken) return matched;
+        matched.clear();
+        for (const SubscriptionPtr& sub : *subs) {
+            if (sub->type != type) continue;
+            const bool tokenMatch = sub->token.isEmpty() || token.isEmpty() || sub->token == token;
+            if (tokenMatch && sub->isAlive()) matched.append(sub);
+        }
+        matchedType = type;
+        matchedToken = token;
+        hasMatch = true;
+        return matched;
+    }
+
+    void post(const std::shared_ptr<MessageDispatcher>& dispatcher, std::function<void()>&& task, MessagePriority priority) {
+        for (auto& pending : posts) {
+            // 组发布：每个分发器只有一个条目，取组内最高优先级
+            if (pending.dispatcher == dispatcher && (grouped || pending.priority == priority)) {
+                pending.priority = qMax(pending.priority, priority);
+                pending.tasks.push_back(std::move(task));
+                return;
+            }
+        }
+        posts.push_back({dispatcher.get(), dispatcher, priority, nullptr, {}});
+        posts.back().tasks.push_back(std::move(task));
+    }
+
+    // actor / 执行器投递（仅组发布模式经由批次）
+    void post(const void* target, Submit&& submit, std::function<void()>&& task) {
+        for (auto& pending : posts) {
+            if (pending.target == target) {
+                pending.tasks.push_back(std::move(task));
+                return;
+            }
+        }
+        posts.push_back({target, nullptr, MessagePriority::Normal, std::move(submit), {}});
+        posts.back().tasks.push_back(std::move(task));
+    }
+
+    // 取出 Publish 为该订阅预留的一个额度（按发布顺序）
+    std::shared_ptr<FlowGate> takeGate(const Subscription* sub) {
+        for (auto it = gates.begin(); it != gates.end(); ++it) {
+            if (it->first != sub) continue;
+            std::shared_ptr<FlowGate> gate = std::move(it->second);
+            gates.erase(it);
+            return gate;
+        }
+        return nullptr;
+    }
+
+    // 把聚合的任务交给各目标
+    void commit() {
+        for (auto& pending : posts) {
+            if (!grouped) {
+                pending.dispatcher->post(std::move(pending.tasks), pending.priority);
+                continue;
+            }
+            auto composite = [tasks = std::move(pending.tasks)] {
+                for (const auto& task : tasks) task();
+            };
+            if (pending.dispatcher) {
+                pending.dispatcher->post(std::move(composite), pending.priority);
+            } else {
+                pending.submit(std::move(composite));
+            }
+        }
+        posts.clear();
+    }
+
+    struct PendingPost {
+        const void* target;
+        std::shared_ptr<MessageDispatcher> dispatcher;
+        MessagePriority priority;
+        Submit submit;
+        std::vector<std::function<void()>> tasks;
+    };
+
+    std::shared_ptr<const SubscriptionList> subs;
+    const bool grouped;
+    quint64 matchedType = 0;
+    MessageToken matchedToken;
+    bool hasMatch = false;
+    Matched matched;
+    std::vector<PendingPost> posts;
+    std::vector<std::pair<const Subscription*, std::shared_ptr<FlowGate>>> gates;  // 组发布预留的额度
+    bool parallel = false;                            // SendParallel：线程无关的处理函数收集为 jobs
+    bool staged = false;                              // Flush：额度不足时不阻塞刷新线程
+    std::vector<std::function<QVariant()>> jobs;
+    const MessageEnvelope* cause = nullptr;  // 暂存时的因果来源
+    qint64 timestampNs = 0;                  // 暂存时的发送时刻
+    quint64 lastSequence = 0;                // 最近一条消息的 sequence
+};
+
+// 单个接收者的信用额度
+struct Messenger::FlowGate {
+    explicit FlowGate(const FlowControlOptions& options)
+        : options(options)
+        , credits(qMax(1, options.credits)) {}
+
+    // 占用一个额度；额度不足时按策略处理，返回 false 表示本次发送应放弃。
+    // mayBlock 为 false 时（刷新暂存区）Block 策略按 WouldBlock 处理
+    bool acquire(quint64 type, bool mayBlock = true) {
+        if (credits.tryAcquire()) return true;
+        switch (options.policy) {
+        case FlowPolicy::Block:
+            if (!mayBlock) return false;
+            return credits.tryAcquire(1, options.blockTimeoutMs < 0 ? -1 : options.blockTimeoutMs);
+        case FlowPolicy::Callback:
+            if (options.onExhausted) options.onExhausted(type);
+            return false;
+        case FlowPolicy::WouldBlock:
+            break;
+        }
+        return false;
+    }
+
+    // 额度总数：一次预留超过它的请求永远不会成功
+    int capacity() const { return qMax(1, options.credits); }
+
+    // 等待至少 n 个额度空闲（不占用）；调用方不得持有任何额度。
+    // deadline 记录本次发送已等待的时间，Block 的超时按整次发送计算
+    bool waitFor(quint64 type, int n, const QElapsedTimer& deadline) {
+        switch (options.policy) {
+        case FlowPolicy::Block: {
+            const int timeout = options.blockTimeoutMs < 0 ? -1 : int(qMax<qint64>(0, options.blockTimeoutMs - deadline.elapsed()));
+            if (!credits.tryAcquire(n, timeout)) return false;
+            credits.release(n);
+            return true;
+        }
+        case FlowPolicy::Callback:
+            if (options.onExhausted) options.onExhausted(type);
+            return false;
+        case FlowPolicy::WouldBlock:
+            break;
+        }
+        return false;
+    }
+
+    // QObject 接收者已析构：额度不再属于该地址上的任何对象
+    bool expired() const { return tracksObject && receiver.isNull(); }
+
+    const FlowControlOptions options;
+    QSemaphore credits;
+    QPointer<QObject> receiver;  // QObject 接收者（actor 由 close() 注销时移除）
+    bool tracksObject = false;
+};
+
+// 单一类型的去重窗口：固定容量的 ID 环 + 首次出现时间表
+struct Messenger::DedupStage {
+    std::function<quint64(const void*)> idOf;
+    DedupOptions options;
+    QMutex mutex;
+    QHash<quint64, qint64> seen;   // id -> 进入窗口的时间
+    std::vector<quint64> ring;     // 按进入顺序排列的 id
+    int head = 0;
+    int count = 0;
+    QElapsedTimer clock;
+    std::atomic<quint64> dropped{0};
+
+    bool accept(const void* message) {
+        const quint64 id = idOf(message);
+        QMutexLocker locker(&mutex);
+        const qint64 now = clock.elapsed();
+        if (options.ttlMs > 0) {
+            while (count > 0 && now - seen.value(ring[head]) >= options.ttlMs) {
+                popOldest();
+            }
+        }
+        if (seen.contains(id)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (count == static_cast<int>(ring.size())) popOldest();
+        ring[(head + count) % ring.size()] = id;
+        ++count;
+        seen.insert(id, now);
+        return true;
+    }
+
+    void popOldest() {
+        seen.remove(ring[head]);
+        head = (head + 1) % ring.size();
+        --count;
+    }
+};
 
 Messenger& Messenger::Default() {
     static Messenger instance;
     return instance;
 }
 
+QThreadPool* Messenger::WorkerPool() {
+    static QThreadPool pool;
+    return &pool;
+}
+
 void Messenger::Unregister(QObject* receiver) {
     if (!receiver) return;
-    for (auto it = subscriptions.begin(); it != subscriptions.end(); ) {
-        if (it->receiver.data() == receiver) {
-            it = subscriptions.erase(it);
+    internalUnregister(receiver);
+}
+
+bool Messenger::Subscription::mailboxClosed() const {
+    return mailbox->isClosed();
+}
+
+void Messenger::Unregister(MessageActor* actor) {
+    if (!actor) return;
+    internalUnregister(actor);
+}
+
+void Messenger::Cleanup() {
+    removeSubscriptions([](const Subscription& sub) { return !sub.isAlive(); });
+
+    QMutexLocker locker(&writeMutex);
+    int expired = 0;
+    for (const auto& gate : *flowGates) {
+        if (gate->expired()) ++expired;
+    }
+    if (expired == 0) return;
+    auto next = std::make_shared<FlowTable>();
+    for (auto it = flowGates->constBegin(); it != flowGates->constEnd(); ++it) {
+        if (!it.value()->expired()) next->insert(it.key(), it.value());
+    }
+    std::atomic_store(&flowGates, std::shared_ptr<const FlowTable>(std::move(next)));
+    flowReceivers.fetch_sub(expired, std::memory_order_release);
+}
+
+void Messenger::registerType(const MessageTypeInfo& info) {
+    QMutexLocker locker(&writeMutex);
+    if (types->contains(info.id)) return;
+    auto next = std::make_shared<TypeTable>(*types);
+    next->insert(info.id, info);
+    std::atomic_store(&types, std::shared_ptr<const TypeTable>(std::move(next)));
+}
+
+MessageTypeInfo Messenger::TypeInfo(quint64 type) const {
+    return std::atomic_load(&types)->value(type);
+}
+
+QList<MessageTypeInfo> Messenger::Types() const {
+    QList<MessageTypeInfo> result = std::atomic_load(&types)->values();
+    std::sort(result.begin(), result.end(), [](const MessageTypeInfo& a, const MessageTypeInfo& b) {
+        return a.name < b.name;
+    });
+    return result;
+}
+
+std::shared_ptr<const Messenger::SubscriptionList> Messenger::snapshot() const {
+    return std::atomic_load(&subscriptions);
+}
+
+void Messenger::addSubscription(std::shared_ptr<Subscription>&& sub) {
+    QMutexLocker locker(&writeMutex);
+    sub->id = nextSubscriptionId++;
+    auto next = std::make_shared<SubscriptionList>(*subscriptions);
+    next->append(std::move(sub));
+    std::atomic_store(&subscriptions, std::shared_ptr<const SubscriptionList>(std::move(next)));
+}
+
+void Messenger::removeSubscriptions(const std::function<bool(const Subscription&)>& match) {
+    QMutexLocker locker(&writeMutex);
+    SubscriptionList kept;
+    kept.reserve(subscriptions->size());
+    for (const auto& sub : *subscriptions) {
+        if (!match(*sub)) kept.append(sub);
+    }
+    if (kept.size() == subscriptions->size()) return;
+    std::atomic_store(&subscriptions, std::shared_ptr<const SubscriptionList>(std::make_shared<SubscriptionList>(std::move(kept))));
+}
+
+void Messenger::internalRegister(quint64 type, const MessageToken& token, QObject* receiver, Handler&& cb,
+                                 std::shared_ptr<MessageExecutor> executor, int flags) {
+    auto sub = std::make_shared<Subscription>();
+    sub->type = type;
+    sub->token = token;
+    sub->receiver = receiver;
+    sub->callback = std::move(cb);
+    sub->consumes = flags & MessengerDetail::TakesRvalue;
+    // 只有经线程分发器排队的投递会合批；执行器接收者每次收到一条
+    if ((flags & MessengerDetail::TakesSpan) && !executor) sub->coalesce = std::make_shared<DeliveryBatch>();
+    sub->executor = std::move(executor);
+    addSubscription(std::move(sub));
+}
+
+void Messenger::internalRegister(quint64 type, const MessageToken& token, MessageActor* actor, Handler&& cb, int flags) {
+    auto sub = std::make_shared<Subscription>();
+    sub->type = type;
+    sub->token = token;
+    sub->callback = std::move(cb);
+    sub->consumes = flags & MessengerDetail::TakesRvalue;
+    sub->actor = actor;
+    sub->mailbox = actor->mailbox;
+    addSubscription(std::move(sub));
+}
+
+void Messenger::internalRegister(quint64 type, const MessageToken& token, std::weak_ptr<const void>&& tracked, const void* key, Handler&& cb,
+                                 std::shared_ptr<MessageExecutor> executor, int flags) {
+    if (!key) return;
+    auto sub = std::make_shared<Subscription>();
+    sub->type = type;
+    sub->token = token;
+    sub->callback = std::move(cb);
+    sub->consumes = flags & MessengerDetail::TakesRvalue;
+    sub->tracked = std::move(tracked);
+    sub->trackedKey = key;
+    sub->executor = std::move(executor);
+    addSubscription(std::move(sub));
+}
+
+void Messenger::internalUnregister(const void* owner) {
+    removeSubscriptions([owner](const Subscription& sub) {
+        return sub.owner() == owner;
+    });
+    internalDisableFlow(owner);
+}
+
+void Messenger::internalUnregister(const void* owner, quint64 type, const MessageToken& token) {
+    removeSubscriptions([owner, type, &token](const Subscription& sub) {
+        return sub.owner() == owner && sub.type == type &&
+               (token.isEmpty() || sub.token == token);
+    });
+}
+
+void Messenger::SetLatencyTracking(bool enabled) {
+    latencyTracking.store(enabled, std::memory_order_relaxed);
+}
+
+QList<SubscriptionStats> Messenger::Stats() const {
+    const auto subs = snapshot();
+    const auto typeTable = std::atomic_load(&types);
+
+    QList<SubscriptionStats> result;
+    result.reserve(subs->size());
+    for (const auto& sub : *subs) {
+        SubscriptionStats stats;
+        stats.id = sub->id;
+        stats.typeHash = sub->type;
+        stats.type = QString::fromLatin1(typeTable->value(sub->type).name);
+        stats.token = sub->token.toString();
+        stats.alive = sub->isAlive();
+
+        if (sub->actor) {
+            stats.receiverKind = "actor";
+            stats.thread = "worker-pool";
+        } else if (sub->trackedKey) {
+            stats.receiverKind = "shared_ptr";
+        } else {
+            stats.receiverKind = "qobject";
+            if (QObject* receiver = sub->receiver.data()) {
+                stats.receiverClass = QString::fromLatin1(receiver->metaObject()->className());
+                stats.objectName = receiver->objectName();
+                if (QThread* thread = receiver->thread()) {
+                    stats.thread = thread->objectName().isEmpty()
+                        ? QString("0x%1").arg(quintptr(thread), 0, 16)
+                        : thread->objectName();
+                }
+            }
+        }
+        if (sub->actor) {
+            stats.dispatch = "actor-mailbox";
+        } else if (sub->executor) {
+            stats.dispatch = "executor";
+            stats.thread = "executor";
+        } else if (sub->trackedKey) {
+            stats.dispatch = "inline";
         } else {
-            ++it;
+            stats.dispatch = "auto-connection";
+        }
+
+        stats.matched = sub->matched.load(std::memory_order_relaxed);
+        stats.delivered = sub->delivered.load(std::memory_order_relaxed);
+        stats.pending = sub->pending.load(std::memory_order_relaxed);
+        for (int i = 0; i <= LatencyHistogram::BucketCount; ++i) {
+            stats.latencyBuckets[i] = sub->latency.buckets[i].load(std::memory_order_relaxed);
         }
+        stats.latencyCount = sub->latency.count.load(std::memory_order_relaxed);
+        stats.latencySumNs = sub->latency.sumNs.load(std::memory_order_relaxed);
+        result.append(stats);
     }
+    return result;
 }
 
-void Messenger::Cleanup() {
-    for (auto it = subscriptions.begin(); it != subscriptions.end(); ) {
-        if (it->receiver.isNull()) {
-            it = subscriptions.erase(it);
-        } else {
-            ++it;
+QByteArray Messenger::DumpSubscriptions(bool indented) const {
+    QJsonArray entries;
+    for (const SubscriptionStats& stats : Stats()) {
+        QJsonObject entry;
+        entry["id"] = qint64(stats.id);
+        entry["type"] = stats.type;
+        entry["typeHash"] = QString::number(stats.typeHash);
+        entry["token"] = stats.token;
+        entry["alive"] = stats.alive;
+        entry["receiverKind"] = stats.receiverKind;
+        if (!stats.receiverClass.isEmpty()) entry["receiverClass"] = stats.receiverClass;
+        if (stats.receiverKind == "qobject") entry["objectName"] = stats.objectName;
+        if (!stats.thread.isEmpty()) entry["thread"] = stats.thread;
+        entry["dispatch"] = stats.dispatch;
+        entry["matched"] = qint64(stats.matched);
+        entry["delivered"] = qint64(stats.delivered);
+        entry["pending"] = qint64(stats.pending);
+        entries.append(entry);
+    }
+
+    QJsonArray typeEntries;
+    for (const MessageTypeInfo& info : Types()) {
+        QJsonObject entry;
+        entry["name"] = QString::fromLatin1(info.name);
+        entry["typeHash"] = QString::number(info.id);
+        entry["metaTypeId"] = info.metaTypeId;
+        entry["size"] = info.size;
+        entry["triviallyCopyable"] = info.triviallyCopyable;
+        entry["serializable"] = info.serializable;
+        entry["moveOnly"] = info.moveOnly;
+        typeEntries.append(entry);
+    }
+
+    QJsonObject root;
+    root["count"] = entries.size();
+    root["subscriptions"] = entries;
+    root["types"] = typeEntries;
+    return QJsonDocument(root).toJson(indented ? QJsonDocument::Indented : QJsonDocument::Compact);
+}
+
+void Messenger::EnableFlowControl(QObject* receiver, const FlowControlOptions& options) {
+    if (receiver) internalEnableFlow(receiver, options, receiver);
+}
+
+void Messenger::EnableFlowControl(MessageActor* actor, const FlowControlOptions& options) {
+    if (actor) internalEnableFlow(actor, options);
+}
+
+void Messenger::DisableFlowControl(QObject* receiver) {
+    internalDisableFlow(receiver);
+}
+
+void Messenger::DisableFlowControl(MessageActor* actor) {
+    internalDisableFlow(actor);
+}
+
+int Messenger::AvailableCredits(QObject* receiver) const {
+    return internalAvailableCredits(receiver);
+}
+
+int Messenger::AvailableCredits(MessageActor* actor) const {
+    return internalAvailableCredits(actor);
+}
+
+void Messenger::internalEnableFlow(const void* owner, const FlowControlOptions& options, QObject* receiver) {
+    auto gate = std::make_shared<FlowGate>(options);
+    if (receiver) {
+        gate->receiver = receiver;
+        gate->tracksObject = true;
+    }
+    bool added = false;
+    {
+        QMutexLocker locker(&writeMutex);
+        auto next = std::make_shared<FlowTable>(*flowGates);
+        added = !next->contains(owner);
+        if (added) flowReceivers.fetch_add(1, std::memory_order_release);
+        next->insert(owner, std::move(gate));
+        std::atomic_store(&flowGates, std::shared_ptr<const FlowTable>(std::move(next)));
+    }
+    // 未注销就析构的接收者：析构时移除额度，避免泄漏并让 Send 回到无流控路径
+    if (receiver && added) {
+        QObject::connect(receiver, &QObject::destroyed, [this, receiver] { internalDisableFlow(receiver); });
+    }
+}
+
+void Messenger::internalDisableFlow(const void* owner) {
+    QMutexLocker locker(&writeMutex);
+    if (!flowGates->contains(owner)) return;
+    auto next = std::make_shared<FlowTable>(*flowGates);
+    next->remove(owner);
+    std::atomic_store(&flowGates, std::shared_ptr<const FlowTable>(std::move(next)));
+    flowReceivers.fetch_sub(1, std::memory_order_release);
+}
+
+void Messenger::SetFanoutOptions(const FanoutOptions& options) {
+    fanoutThreshold.store(options.threshold, std::memory_order_relaxed);
+    fanoutChunk.store(qMax(1, options.chunkSize), std::memory_order_relaxed);
+}
+
+FanoutOptions Messenger::Fanout() const {
+    FanoutOptions options;
+    options.threshold = fanoutThreshold.load(std::memory_order_relaxed);
+    options.chunkSize = fanoutChunk.load(std::memory_order_relaxed);
+    return options;
+}
+
+int Messenger::internalAvailableCredits(const void* owner) const {
+    const auto gate = liveGate(*std::atomic_load(&flowGates), owner);
+    return gate ? gate->credits.available() : -1;
+}
+
+std::shared_ptr<Messenger::FlowGate> Messenger::liveGate(const FlowTable& gates, const void* owner) {
+    std::shared_ptr<FlowGate> gate = gates.value(owner);
+    if (gate && gate->expired()) return nullptr;
+    return gate;
+}
+
+void Messenger::internalSetPriority(quint64 type, MessagePriority priority) {
+    QMutexLocker locker(&writeMutex);
+    const bool present = priorities->contains(type);
+    if (priority == MessagePriority::Normal && !present) return;
+    auto next = std::make_shared<PriorityTable>(*priorities);
+    if (priority == MessagePriority::Normal) {
+        next->remove(type);
+        prioritizedTypes.fetch_sub(1, std::memory_order_release);
+    } else {
+        next->insert(type, priority);
+        if (!present) prioritizedTypes.fetch_add(1, std::memory_order_release);
+    }
+    std::atomic_store(&priorities, std::shared_ptr<const PriorityTable>(std::move(next)));
+}
+
+MessagePriority Messenger::internalPriority(quint64 type) const {
+    if (prioritizedTypes.load(std::memory_order_acquire) == 0) return MessagePriority::Normal;
+    return std::atomic_load(&priorities)->value(type, MessagePriority::Normal);
+}
+
+void Messenger::internalEnableDedup(quint64 type, std::function<quint64(const void*)>&& idOf, const DedupOptions& options) {
+    auto stage = std::make_shared<DedupStage>();
+    stage->idOf = std::move(idOf);
+    stage->options = options;
+    stage->ring.resize(qMax(1, options.windowSize));
+    stage->seen.reserve(qMax(1, options.windowSize));
+    stage->clock.start();
+
+    QMutexLocker locker(&writeMutex);
+    auto next = std::make_shared<DedupTable>(*dedupStages);
+    if (!next->contains(type)) dedupTypes.fetch_add(1, std::memory_order_release);
+    next->insert(type, std::move(stage));
+    std::atomic_store(&dedupStages, std::shared_ptr<const DedupTable>(std::move(next)));
+}
+
+void Messenger::internalDisableDedup(quint64 type) {
+    QMutexLocker locker(&writeMutex);
+    if (!dedupStages->contains(type)) return;
+    auto next = std::make_shared<DedupTable>(*dedupStages);
+    next->remove(type);
+    dedupTypes.fetch_sub(1, std::memory_order_release);
+    std::atomic_store(&dedupStages, std::shared_ptr<const DedupTable>(std::move(next)));
+}
+
+bool Messenger::internalAcceptDedup(quint64 type, const void* message) {
+    // 无锁取快照；未启用去重的类型不加任何锁
+    const auto stage = std::atomic_load(&dedupStages)->value(type);
+    return !stage || stage->accept(message);
+}
+
+quint64 Messenger::internalDuplicatesDropped(quint64 type) {
+    const auto stage = std::atomic_load(&dedupStages)->value(type);
+    return stage ? stage->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+void Messenger::SetSendStaging(bool enabled) {
+    if (!enabled && stagingEnabled) {
+        stagingEnabled = false;
+        Flush();
+        return;
+    }
+    if (enabled && !staging.buffer) staging.buffer = new StagingBuffer(this);
+    stagingEnabled = enabled;
+}
+
+bool Messenger::SendStaging() const {
+    return stagingEnabled;
+}
+
+int Messenger::Flush() {
+    StagingBuffer* buffer = staging.buffer;
+    if (!buffer || buffer->entries.empty()) return 0;
+    // 先取出全部条目：处理函数在刷新期间的 Send 进入下一批
+    std::vector<StagedSend> entries;
+    entries.swap(buffer->entries);
+
+    SendBatch batch(snapshot());
+    batch.staged = true;
+    int dropped = 0;
+    for (const StagedSend& entry : entries) {
+        batch.cause = entry.caused ? &entry.cause : nullptr;
+        batch.timestampNs = entry.timestampNs;
+        const bool sent = entry.payload.use([&](const QVariant& payload) {
+            return dispatchSend(entry.type, entry.token, payload, entry.correlationId, &batch);
+        });
+        if (!sent) ++dropped;
+    }
+    batch.commit();
+    return dropped;
+}
+
+SendResult Messenger::Publish(const PublishGroup& group, quint64 correlationId) {
+    if (group.isEmpty()) return SendResult::Ok;
+    SendBatch batch(snapshot(), true);
+    batch.cause = currentEnvelope;
+
+    // 流控：按接收者汇总整组的排队投递数，逐个一次性预留（全有或全无）。
+    // 额度不足时先归还已预留的部分再按策略等待，Block 策略不会等待自己持有的额度
+    if (flowReceivers.load(std::memory_order_acquire) != 0) {
+        struct Demand {
+            std::shared_ptr<FlowGate> gate;
+            int count;
+            quint64 type;  // 第一条占用该额度的消息类型（Callback 策略的参数）
+        };
+        QVarLengthArray<Demand, 4> demands;
+        const auto gates = std::atomic_load(&flowGates);
+        for (const PublishGroup::Entry& entry : group.entries) {
+            for (const SubscriptionPtr& sub : batch.match(entry.type, entry.token)) {
+                if (!SendBatch::queued(sub)) continue;
+                std::shared_ptr<FlowGate> gate = liveGate(*gates, sub->owner());
+                if (!gate) continue;
+                auto it = std::find_if(demands.begin(), demands.end(), [&gate](const Demand& d) { return d.gate == gate; });
+                if (it == demands.end()) {
+                    demands.append({gate, 1, entry.type});
+                } else {
+                    ++it->count;
+                }
+                batch.gates.emplace_back(sub.get(), std::move(gate));
+            }
+        }
+        // 单个接收者的投递数超过其额度总数：整组永远无法预留
+        for (const Demand& d : demands) {
+            if (d.count > d.gate->capacity()) return SendResult::WouldBlock;
+        }
+        QElapsedTimer waited;
+        waited.start();
+        const int total = int(demands.size());
+        for (;;) {
+            int taken = 0;
+            while (taken < total && demands[taken].gate->credits.tryAcquire(demands[taken].count)) ++taken;
+            if (taken == total) break;
+            for (int i = 0; i < taken; ++i) demands[i].gate->credits.release(demands[i].count);
+            const Demand& blocked = demands[taken];
+            if (!blocked.gate->waitFor(blocked.type, blocked.count, waited)) return SendResult::WouldBlock;
         }
     }
+
+    for (const PublishGroup::Entry& entry : group.entries) {
+        dispatchSend(entry.type, entry.token, entry.payload, correlationId, &batch);
+        if (!correlationId && !currentEnvelope) correlationId = batch.lastSequence;
+    }
+    batch.commit();
+    // 预留后接收者不再匹配（已注销 / 移到发送线程）时归还剩余额度
+    for (const auto& reserved : batch.gates) reserved.second->credits.release();
+    return SendResult::Ok;
 }
 
-void Messenger::internalRegister(quint64 type, const MessageToken& token, QObject* receiver, std::function<void(const QVariant&)>&& cb) {
-    subscriptions.append({type, token, QPointer<QObject>(receiver), std::move(cb)});
+void Messenger::internalSendParallel(quint64 type, const MessageToken& token, const QVariant& payload,
+                                     std::function<void(const QVariant&)>&& onResult, std::function<void()>&& onFinished) {
+    SendBatch batch(snapshot());
+    batch.parallel = true;
+    batch.cause = currentEnvelope;
+    dispatchSend(type, token, payload, 0, &batch);
+    batch.commit();
+    if (batch.jobs.empty()) {
+        onFinished();
+        return;
+    }
+
+    // 各任务共享结果回调与剩余计数，最后完成的任务结束 QFuture
+    struct ParallelState {
+        std::function<void(const QVariant&)> onResult;
+        std::function<void()> onFinished;
+        std::atomic<int> remaining;
+    };
+    auto state = std::make_shared<ParallelState>();
+    state->onResult = std::move(onResult);
+    state->onFinished = std::move(onFinished);
+    state->remaining.store(int(batch.jobs.size()), std::memory_order_relaxed);
+    for (auto& job : batch.jobs) {
+        WorkerPool()->start([state, job = std::move(job)] {
+            state->onResult(job());
+            if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) state->onFinished();
+        });
+    }
 }
 
-void Messenger::internalSend(quint64 type, const MessageToken& token, const QVariant& payload) {
-    for (const auto& sub : std::as_const(subscriptions)) {
-        if (sub.type != type) continue;
-        const bool tokenMatch = sub.token.isEmpty() || token.isEmpty() || sub.token == token;
-        if (!tokenMatch) continue;
-        if (sub.receiver.isNull()) continue;
+bool Messenger::internalSend(quint64 type, const MessageToken& token, const QVariant& payload, quint64 correlationId, bool owned) {
+    if (stagingEnabled) {
+        StagedSend entry{type, token, HeldPayload(payload), correlationId, monotonicNs(), false, MessageEnvelope()};
+        if (const MessageEnvelope* cause = currentEnvelope) {
+            entry.caused = true;
+            entry.cause = *cause;
+        }
+        staging.buffer->stage(std::move(entry));
+        return true;
+    }
+    return dispatchSend(type, token, payload, correlationId, nullptr, owned);
+}
+
+bool Messenger::dispatchSend(quint64 type, const MessageToken& token, const QVariant& payload, quint64 correlationId, SendBatch* batch, bool owned) {
+    SendBatch::Matched local;
+    if (!batch) {
+        const auto subs = snapshot();
+        for (const SubscriptionPtr& sub : *subs) {
+            if (sub->type != type) continue;
+            const bool tokenMatch = sub->token.isEmpty() || token.isEmpty() || sub->token == token;
+            if (tokenMatch && sub->isAlive()) local.append(sub);
+        }
+    }
+    const SendBatch::Matched& all = batch ? batch->match(type, token) : local;
+    // 仅可移动的消息只有一个消费者：按注册顺序第一个匹配且存活的订阅
+    SendBatch::Matched single;
+    const bool exclusive = all.size() > 1 && payload.userType() == qMetaTypeId<MessengerDetail::OwnedMessage>();
+    if (exclusive) single.append(all.at(0));
+    const SendBatch::Matched& matched = exclusive ? single : all;
+
+    // 流控：先为所有受控接收者预留额度（全有或全无）
+    QVarLengthArray<std::pair<const Subscription*, std::shared_ptr<FlowGate>>, 4> reserved;
+    const bool grouped = batch && batch->grouped;  // 组发布：额度已由 Publish 预留，投递按目标合并
+    if (!grouped && flowReceivers.load(std::memory_order_acquire) != 0) {
+        // 批内尚未交出的任务占用着额度，先交出再等待，避免 Block 策略自锁
+        if (batch) batch->commit();
+        const auto gates = std::atomic_load(&flowGates);
+        for (const SubscriptionPtr& sub : matched) {
+            if (!SendBatch::queued(sub)) continue;
+            std::shared_ptr<FlowGate> gate = liveGate(*gates, sub->owner());
+            if (!gate) continue;
+            if (!gate->acquire(type, !(batch && batch->staged))) {
+                for (const auto& r : reserved) r.second->credits.release();
+                return false;
+            }
+            reserved.append({sub.get(), std::move(gate)});
+        }
+    }
+    const auto gateOf = [&reserved, batch, grouped](const Subscription* sub) {
+        if (grouped) return batch->takeGate(sub);
+        for (const auto& r : reserved) {
+            if (r.first == sub) return r.second;
+        }
+        return std::shared_ptr<FlowGate>();
+    };
 
-        QMetaObject::invokeMethod(sub.receiver, [sub, payload] {
-            sub.callback(payload);
-        }, Qt::AutoConnection);
+    MessageEnvelope envelope;
+    envelope.timestampNs = batch && batch->timestampNs ? batch->timestampNs : monotonicNs();
+    envelope.sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+    if (batch) batch->lastSequence = envelope.sequence;
+    envelope.senderThread = QThread::currentThread();
+    if (const MessageEnvelope* cause = batch ? batch->cause : currentEnvelope) {
+        envelope.causationId = cause->sequence;
+        envelope.correlationId = correlationId ? correlationId : cause->correlationId;
+    } else {
+        envelope.correlationId = correlationId ? correlationId : envelope.sequence;
     }
-}
\ No newline at end of file
+    std::shared_ptr<MessageTracer> activeTracer;
+    if (tracing.load(std::memory_order_acquire)) {
+        activeTracer = std::atomic_load(&tracer);
+        if (activeTracer) activeTracer->onSend(type, envelope);
+    }
+
+    // 回调执行：记录延迟与投递计数
+    const bool trackLatency = latencyTracking.load(std::memory_order_relaxed);
+    const auto deliver = [trackLatency](const SubscriptionPtr& sub, const QVariant& payload, const MessageEnvelope& envelope) {
+        if (trackLatency) sub->latency.record(monotonicNs() - envelope.timestampNs);
+        sub->delivered.fetch_add(1, std::memory_order_relaxed);
+        MESSENGER_HOOK(HandlerBegin, sub->type, sub->id);
+        const MessageEnvelope* outer = currentEnvelope;
+        currentEnvelope = &envelope;
+        QVariant result = sub->callback(payload, envelope);
+        currentEnvelope = outer;
+        MESSENGER_HOOK(HandlerEnd, sub->type, sub->id);
+        return result;
+    };
+
+    // 排队投递：actor / 执行器 / 跨线程分发器。不依赖调用线程，大扇出时由工作线程分块代为执行
+    const auto enqueue = [&](const SubscriptionPtr& sub, MessagePriority priority) {
+        // 预留的额度在处理函数返回后归还
+        std::shared_ptr<FlowGate> gate = (reserved.isEmpty() && !grouped) ? nullptr : gateOf(sub.get());
+        sub->pending.fetch_add(1, std::memory_order_relaxed);
+        MESSENGER_HOOK(Enqueue, sub->type, sub->id);
+        if (sub->actor) {
+            auto task = heldTask(payload, [sub, envelope, deliver, gate](const auto& held) {
+                sub->pending.fetch_sub(1, std::memory_order_relaxed);
+                MESSENGER_HOOK(Dequeue, sub->type, sub->id);
+                held.use([&](const QVariant& p) { return deliver(sub, p, envelope); });
+                if (gate) gate->credits.release();
+            });
+            if (grouped) {
+                batch->post(sub->actor, [sub](std::function<void()>&& t) { sub->mailbox->post(std::move(t)); }, std::move(task));
+            } else {
+                // 邮箱已关闭（Actor 已注销并析构）时任务被丢弃，不会访问 Actor
+                if (!sub->mailbox->post(std::move(task))) {
+                    sub->pending.fetch_sub(1, std::memory_order_relaxed);
+                    if (gate) gate->credits.release();
+                }
+            }
+            return;
+        }
+        if (sub->executor) {
+            auto task = heldTask(payload, [sub, envelope, deliver, gate](const auto& held) {
+                sub->pending.fetch_sub(1, std::memory_order_relaxed);
+                MESSENGER_HOOK(Dequeue, sub->type, sub->id);
+                // 线程执行器的目标线程已结束时以取消模式执行：只归还额度
+                if (!MessageDispatcher::Cancelling() && sub->isAlive()) held.use([&](const QVariant& p) { return deliver(sub, p, envelope); });
+                if (gate) gate->credits.release();
+            });
+            if (grouped) {
+                batch->post(sub->executor.get(), [sub, priority](std::function<void()>&& t) { sub->executor->executeWithPriority(std::move(t), priority); }, std::move(task));
+            } else {
+                sub->executor->executeWithPriority(std::move(task), priority);
+            }
+            return;
+        }
+
+        // 跨线程 QObject 接收者：交给目标线程的分发器，与其他投递合并唤醒
+        QObject* receiver = sub->receiver.data();
+        const auto dispatcher = MessageDispatcher::ForThread(receiver ? receiver->thread() : nullptr);
+        if (!dispatcher) {
+            sub->pending.fetch_sub(1, std::memory_order_relaxed);
+            if (gate) gate->credits.release();
+            return;
+        }
+        std::function<void()> task;
+        if (sub->coalesce) {
+            // 批量处理函数：已有排空任务在途时只追加条目
+            {
+                QMutexLocker locker(&sub->coalesce->mutex);
+                auto& items = sub->coalesce->items;
+                items.push_back({HeldPayload(payload), envelope, gate});
+                if (items.size() > 1) return;
+            }
+            task = [sub, deliver, trackLatency] {
+                std::vector<DeliveryBatch::Item> items;
+                {
+                    QMutexLocker locker(&sub->coalesce->mutex);
+                    items.swap(sub->coalesce->items);
+                }
+                const quint64 count = items.size();
+                sub->pending.fetch_sub(count, std::memory_order_relaxed);
+                MESSENGER_HOOK(Dequeue, sub->type, sub->id);
+                // 目标线程已结束时分发器以取消模式执行：只归还额度
+                QObject* current = sub->receiver.data();
+                if (!MessageDispatcher::Cancelling() && current && current->thread() == QThread::currentThread()) {
+                    // 最后一条的延迟与投递计数由 deliver 记录
+                    if (trackLatency) {
+                        const qint64 now = monotonicNs();
+                        for (quint64 i = 0; i + 1 < count; ++i) sub->latency.record(now - items[i].envelope.timestampNs);
+                    }
+                    sub->delivered.fetch_add(count - 1, std::memory_order_relaxed);
+                    const MessageEnvelope last = items.back().envelope;
+                    if (count == 1) {
+                        items.front().payload.use([&](const QVariant& p) { return deliver(sub, p, last); });
+                    } else {
+                        QVariant combined = QVariant::fromValue(MessengerDetail::PayloadBatch());
+                        // 直接填充 QVariant 内的批次，条目载荷不额外共享，右值取用时可以移动
+                        auto& batchItems = static_cast<MessengerDetail::PayloadBatch*>(combined.data())->items;
+                        batchItems.reserve(count);
+                        for (auto& item : items) batchItems.push_back(item.payload.take());
+                        deliver(sub, combined, last);
+                    }
+                }
+                for (const auto& item : items) {
+                    if (item.gate) item.gate->credits.release();
+                }
+            };
+        } else {
+            task = heldTask(payload, [sub, envelope, deliver, gate](const auto& held) {
+                sub->pending.fetch_sub(1, std::memory_order_relaxed);
+                MESSENGER_HOOK(Dequeue, sub->type, sub->id);
+                // 接收者已析构、在排队期间被移到其他线程，或目标线程已结束（取消模式）时丢弃本次投递
+                QObject* current = sub->receiver.data();
+                if (!MessageDispatcher::Cancelling() && current && current->thread() == QThread::currentThread()) {
+                    held.use([&](const QVariant& p) { return deliver(sub, p, envelope); });
+                }
+                if (gate) gate->credits.release();
+            });
+        }
+        if (batch) {
+            batch->post(dispatcher, std::move(task), priority);
+        } else {
+            dispatcher->post(std::move(task), priority);
+        }
+    };
+
+    MESSENGER_HOOK(BeforeMatch, type, 0);
+    const int matchCount = matched.size();
+    const int threshold = fanoutThreshold.load(std::memory_order_relaxed);
+    const bool fanOut = !batch && threshold > 0 && matchCount >= threshold;
+    std::vector<SubscriptionPtr> wide;  // 大扇出：收集排队投递，之后分块并行
+    // 右值处理函数会取走载荷：同步投递时传入副本，其余接收者仍看到原消息；
+    // 载荷由本次 Send 独占且只有这一个订阅时直接移动
+    const bool movable = owned && matchCount == 1;
+    const auto deliverNow = [&](const SubscriptionPtr& sub) {
+        return (sub->consumes && !movable) ? deliver(sub, QVariant(payload), envelope) : deliver(sub, payload, envelope);
+    };
+    // 优先级只在第一次排队时查表
+    MessagePriority priority = MessagePriority::Normal;
+    bool priorityKnown = false;
+    for (const SubscriptionPtr& sub : matched) {
+        sub->matched.fetch_add(1, std::memory_order_relaxed);
+
+        if (sub->trackedKey && !sub->executor) {
+            if (batch && batch->parallel) {
+                // 并行发送：交给 WorkerPool()，结果由 SendParallel 汇总
+                batch->jobs.push_back(heldTask<QVariant>(payload, [sub, envelope, deliver](const auto& held) {
+                    return held.use([&](const QVariant& p) { return deliver(sub, p, envelope); });
+                }));
+                continue;
+            }
+            // 无线程归属：在发送线程中直接调用（回调内部 lock weak_ptr）
+            deliverNow(sub);
+            continue;
+        }
+
+        // QObject 接收者与发送方同线程：直接调用（不占用流控额度）
+        QObject* receiver = (sub->actor || sub->executor) ? nullptr : sub->receiver.data();
+        if (receiver && receiver->thread() == QThread::currentThread()) {
+            deliverNow(sub);
+            continue;
+        }
+
+        if (!priorityKnown) {
+            priority = internalPriority(type);
+            priorityKnown = true;
+        }
+        if (fanOut) {
+            wide.push_back(sub);
+            continue;
+        }
+        enqueue(sub, priority);
+    }
+
+    if (!wide.empty()) {
+        // 分块：发送线程与 WorkerPool() 中的协助任务从同一计数器领取分块，
+        // 发送线程只等待已被领取的分块完成；返回前全部排队完毕，每个接收者的顺序不变
+        struct FanoutState {
+            std::atomic<int> next{0};
+            std::atomic<int> done{0};
+            QSemaphore finished;
+        };
+        const int chunkSize = qMax(1, fanoutChunk.load(std::memory_order_relaxed));
+        const int chunks = (int(wide.size()) + chunkSize - 1) / chunkSize;
+        auto state = std::make_shared<FanoutState>();
+        // 只有领取到分块（c < chunks）时才访问发送线程栈上的数据，此时发送线程必在等待
+        const auto runChunks = [&wide, &enqueue, priority, chunkSize, chunks](FanoutState& s) {
+            for (int c = s.next.fetch_add(1, std::memory_order_relaxed); c < chunks; c = s.next.fetch_add(1, std::memory_order_relaxed)) {
+                const int end = qMin(int(wide.size()), (c + 1) * chunkSize);
+                for (int i = c * chunkSize; i < end; ++i) enqueue(wide[i], priority);
+                if (s.done.fetch_add(1, std::memory_order_acq_rel) + 1 == chunks) s.finished.release();
+            }
+        };
+        const int helpers = qMin(chunks - 1, WorkerPool()->maxThreadCount());
+        for (int i = 0; i < helpers; ++i) {
+            WorkerPool()->start([state, runChunks] { runChunks(*state); });
+        }
+        runChunks(*state);
+        state->finished.acquire();
+    }
+    if (activeTracer) activeTracer->onMatched(envelope.sequence, matchCount);
+    MESSENGER_HOOK(AfterMatch, type, matchCount);
+    return true;
+}
+
+const MessageEnvelope* Messenger::CurrentEnvelope() {
+    return currentEnvelope;
+}
+
+void Messenger::SetTracer(std::shared_ptr<MessageTracer> tracer) {
+    const bool enabled = tracer != nullptr;
+    std::atomic_store(&this->tracer, std::move(tracer));
+    tracing.store(enabled, std::memory_order_release);
+}
+
+// ----------------------------------------------------------
+// 插桩 Hook：运行时回调策略
+// ----------------------------------------------------------
+std::atomic<MessengerHookFn> MessengerCallbackHooks::callback{nullptr};
+
+void MessengerCallbackHooks::SetCallback(MessengerHookFn fn) {
+    callback.store(fn, std::memory_order_release);
+}
@@ -7,11 +7,27 @@
 #include <QSet>
 #include <QPointer>
 #include <QThread>
+#include <QMutex>
+#include <QDataStream>
+#include <QFuture>
+#include <QFutureInterface>
 #include <typeinfo>
 #include <functional>
+#include <memory>
+#include <atomic>
+#include <type_traits>
+#include <vector>
+#include <cstring>
+#include <new>
 #include <qDebug>
 
 class Messenger;
+class MessageActor;
+class MessageMailbox;
+class MessageExecutor;
+class MessageTracer;
+class PublishGroup;
+class QThreadPool;
 
 #ifdef MESSAGING_LIBRARY
 #  define MESSAGING_API Q_DECL_EXPORT
@@ -33,11 +49,387 @@ public:
 };
 inline uint qHash(const MessageToken& token, uint seed = 0) noexcept { return qHash(token.toString(), seed); }
 
+// 按消息 ID 去重的窗口配置
+struct DedupOptions {
+    int windowSize = 4096;  // 记住最近多少个 ID
+    int ttlMs = 10000;      // ID 在窗口中保留的时长（<= 0 表示只按数量淘汰）
+};
+
+// 流控策略：接收者额度耗尽时 Send 的行为
+enum class FlowPolicy {
+    Block,       // 阻塞发送线程直到有额度（或超时）
+    WouldBlock,  // 立即返回 SendResult::WouldBlock，不投递
+    Callback,    // 在发送线程调用 onExhausted 后按 WouldBlock 返回
+};
+
+// 信用额度流控配置（按接收者）
+struct FlowControlOptions {
+    int credits = 256;                              // 最多在途（已排队尚未处理完）的投递数
+    FlowPolicy policy = FlowPolicy::Block;
+    int blockTimeoutMs = -1;                        // Block 的最长等待（< 0 不限时；超时按 WouldBlock 处理）
+    std::function<void(quint64 type)> onExhausted;  // Callback 策略的生产者回调（参数为类型键）
+};
+
+// 跨线程投递的优先级：目标线程的分发器先处理高优先级，同一优先级内保持发送顺序
+enum class MessagePriority {
+    Low = 0,
+    Normal = 1,
+    High = 2,
+};
+
+// 大扇出并行排队：匹配的订阅数达到阈值时，排队投递分块交给工作线程并行完成
+struct FanoutOptions {
+    int threshold = 4096;  // 触发分块的匹配订阅数（<= 0 关闭）
+    int chunkSize = 512;   // 每块订阅数
+};
+
+enum class SendResult {
+    Ok,          // 已接受（包括被去重丢弃、类型被禁用）
+    WouldBlock,  // 受流控接收者额度不足，整条消息未投递
+};
+
+// 投递延迟直方图（Send → 回调开始），无锁累加
+struct LatencyHistogram {
+    static constexpr int BucketCount = 10;
+    // 各桶上界（微秒），最后一个桶之外计入 +Inf
+    static constexpr qint64 BoundsUs[BucketCount] = {10, 50, 100, 250, 500, 1000, 5000, 10000, 50000, 250000};
+
+    std::atomic<quint64> buckets[BucketCount + 1] {};
+    std::atomic<quint64> count{0};
+    std::atomic<quint64> sumNs{0};
+
+    void record(qint64 ns) {
+        const qint64 us = ns / 1000;
+        int i = 0;
+        while (i < BucketCount && us > BoundsUs[i]) ++i;
+        buckets[i].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sumNs.fetch_add(quint64(ns > 0 ? ns : 0), std::memory_order_relaxed);
+    }
+};
+
+// 消息类型信息：类型首次 Register/Send 时登记，按类型键 O(1) 查询
+struct MessageTypeInfo {
+    quint64 id = 0;                  // 类型键（typeid hash）
+    int metaTypeId = 0;
+    QByteArray name;                 // 元类型名
+    int size = 0;                    // sizeof
+    bool triviallyCopyable = false;
+    bool serializable = false;       // 存在 QDataStream << / >> 运算符
+    bool moveOnly = false;           // 仅可移动：载荷以共享指针保存，只投递给一个消费者
+};
+
+// ──────────────────────────────────────────────────────────────
+// 消息信封：随载荷一起投递的元数据
+//
+// 在 Send 时生成，按值保存在投递任务中（不额外分配）。处理函数可选地
+// 以第二个参数接收：void onMessage(const MyMessage&, const MessageEnvelope&)
+// ──────────────────────────────────────────────────────────────
+struct MessageEnvelope {
+    qint64 timestampNs = 0;           // 发送时刻（steady clock，纳秒）
+    quint64 sequence = 0;             // 全局递增的发送序号
+    QThread* senderThread = nullptr;  // 发送线程
+    quint64 correlationId = 0;        // 关联 ID：未指定时继承当前处理中消息的关联 ID，否则取本条消息的 sequence
+    quint64 causationId = 0;          // 直接原因：在处理函数中发送时为当前消息的 sequence，否则为 0
+};
+
+// 单个订阅的统计快照（Stats() / DumpSubscriptions() / 指标导出共用）
+struct SubscriptionStats {
+    quint64 id = 0;
+    quint64 typeHash = 0;
+    QString type;           // 元类型名
+    QString token;
+    bool alive = false;
+    QString receiverKind;   // qobject / actor / shared_ptr
+    QString receiverClass;
+    QString objectName;
+    QString thread;         // 接收者线程（objectName 或地址）
+    QString dispatch;       // auto-connection / actor-mailbox / executor / inline
+    quint64 matched = 0;
+    quint64 delivered = 0;
+    quint64 pending = 0;    // 已排队尚未执行的投递
+    quint64 latencyBuckets[LatencyHistogram::BucketCount + 1] = {};  // 非累积
+    quint64 latencyCount = 0;
+    quint64 latencySumNs = 0;
+};
+
+// ──────────────────────────────────────────────────────────────
+// 编译期禁用消息类型
+//
+// 特化为 false 的类型在本构建中 Register / Send / SendWith 均为编译期空操作：
+// 不构造 QVariant、不扫描订阅表，SendWith 的工厂函数也不会被调用。
+// 典型用法是只在调试构建中启用的诊断消息：
+//
+//   DECLARE_MESSAGE_TYPE(TraceMessage)
+//   #ifdef QT_NO_DEBUG
+//   DISABLE_MESSAGE_TYPE(TraceMessage)
+//   #endif
+//
+// 或直接使用 DECLARE_DEBUG_MESSAGE_TYPE(TraceMessage)。
+// 需在首次 Register/Send 该类型之前声明（与普通模板特化规则一致）。
+// ──────────────────────────────────────────────────────────────
+template<typename T>
+struct MessageTypeEnabled : std::true_type {};
+
+// 仅可移动消息类型的名字（见 DECLARE_MOVE_ONLY_MESSAGE_TYPE），未声明时使用 typeid 名
+template<typename T>
+struct MoveOnlyMessageName {
+    static const char* value() { return typeid(T).name(); }
+};
+
+// 连续消息视图（C++17 没有 std::span）：批量处理函数的参数
+template<typename T>
+class MessageSpan {
+public:
+    MessageSpan(T* data, std::size_t size) : ptr(data), count(size) {}
+
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + count; }
+    T* data() const { return ptr; }
+    T& operator[](std::size_t index) const { return ptr[index]; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    T* ptr;
+    std::size_t count;
+};
+
+namespace MessengerDetail {
+// 去重键：整数 / 枚举 ID 原样使用，其余类型以两个种子的 qHash 拼成 64 位
+template<typename T>
+quint64 dedupKey(const T& id) {
+    if constexpr (std::is_integral<T>::value || std::is_enum<T>::value) {
+        return static_cast<quint64>(id);
+    } else {
+        return (quint64(qHash(id, 0x9e3779b9U)) << 32) | quint64(qHash(id, 0x85ebca6bU));
+    }
+}
+
+// 处理函数的返回值：已注册元类型的结果包装为 QVariant（供 SendParallel 收集），其余丢弃
+template<typename F>
+QVariant resultOf(F&& call) {
+    using R = std::decay_t<decltype(call())>;
+    if constexpr (std::is_void<R>::value) {
+        call();
+        return QVariant();
+    } else if constexpr (QMetaTypeId2<R>::Defined) {
+        return QVariant::fromValue(call());
+    } else {
+        call();
+        return QVariant();
+    }
+}
+
+// 合批投递的载荷：批量处理函数一次收到的多条消息
+struct PayloadBatch {
+    std::vector<QVariant> items;
+};
+
+// 仅可移动的消息：QVariant 要求可复制，载荷中只保存指向消息的共享指针。
+// 总线保证这类消息只投递给一个消费者，由它取走消息
+struct OwnedMessage {
+    std::shared_ptr<void> message;
+};
+
+template<typename T>
+constexpr bool isMoveOnly() {
+    return !std::is_copy_constructible<T>::value;
+}
+
+// 小消息的内联存储：可平凡复制且不超过 InlineCapacity 字节的消息不经 QVariant 分配。
+// 发送期间字节位于发送方栈上的 InlineBytes，载荷只保存其地址（指针大小，QVariant 内部存储）；
+// 排队投递、暂存与合批时字节复制进投递记录本身
+constexpr std::size_t InlineCapacity = 64;
+
+struct InlineBytes {
+    alignas(16) unsigned char data[InlineCapacity];
+};
+
+struct InlineMessage {
+    const InlineBytes* bytes;
+};
+
+template<typename T>
+constexpr bool isInline() {
+    return !isMoveOnly<T>() && std::is_trivially_copyable<T>::value &&
+           sizeof(T) <= InlineCapacity && alignof(T) <= alignof(InlineBytes);
+}
+
+// 载荷为内联小消息时返回其字节，否则返回 nullptr
+inline const InlineBytes* inlineBytes(const QVariant& var);
+
+// 发送期间的载荷（小消息的字节与指向它的 QVariant 一起留在发送方栈上）
+template<typename TMsg, bool = isInline<TMsg>()>
+struct SendPayload {
+    QVariant variant;
+    explicit SendPayload(const TMsg& message) { variant.setValue(message); }
+};
+
+// 处理函数对消息的接收方式（注册时由签名推导）
+enum HandlerFlag {
+    TakesSpan = 0x1,    // MessageSpan<const T>：跨线程投递在订阅内合批
+    TakesRvalue = 0x2,  // T&&：同步投递时传入副本，排队投递在独占载荷时移动
+};
+
+// 处理函数可只接收消息，或同时接收信封
+template<typename F, typename Arg>
+constexpr bool accepts() {
+    return std::is_invocable<const F&, Arg, const MessageEnvelope&>::value ||
+           std::is_invocable<const F&, Arg>::value;
+}
+
+// 按 const T& → T&& → MessageSpan<const T> → shared_ptr<const T> 的顺序检测：
+// 泛型 lambda（const auto& / auto）在第一步即匹配，不会以 MessageSpan 实例化函数体；
+// 批量处理函数必须显式写出 MessageSpan<const T> 参数
+template<typename TMsg, typename F>
+constexpr bool takesSpan() {
+    return !accepts<F, const TMsg&>() && !accepts<F, TMsg&&>() && accepts<F, MessageSpan<const TMsg>>();
+}
+
+template<typename TMsg, typename F>
+constexpr int handlerFlags() {
+    if constexpr (accepts<F, const TMsg&>()) {
+        return 0;
+    } else if constexpr (accepts<F, TMsg&&>()) {
+        return TakesRvalue;
+    } else if constexpr (takesSpan<TMsg, F>()) {
+        return TakesSpan;
+    } else {
+        return 0;
+    }
+}
+
+template<typename F, typename Arg>
+QVariant callWith(const F& handler, Arg&& arg, const MessageEnvelope& envelope) {
+    if constexpr (std::is_invocable<const F&, Arg, const MessageEnvelope&>::value) {
+        return resultOf([&] { return handler(std::forward<Arg>(arg), envelope); });
+    } else {
+        Q_UNUSED(envelope)
+        return resultOf([&] { return handler(std::forward<Arg>(arg)); });
+    }
+}
+
+// 载荷内的消息（不复制）
+template<typename TMsg>
+const TMsg& messageRef(const QVariant& var) {
+    if constexpr (isInline<TMsg>()) {
+        // 发布组、并行发送等路径仍以普通 QVariant 保存小消息
+        if (const InlineBytes* bytes = inlineBytes(var)) return *std::launder(reinterpret_cast<const TMsg*>(bytes->data));
+        Q_ASSERT(var.userType() == qMetaTypeId<TMsg>());
+        return *static_cast<const TMsg*>(var.constData());
+    } else if constexpr (isMoveOnly<TMsg>()) {
+        Q_ASSERT(var.userType() == qMetaTypeId<OwnedMessage>());
+        return *static_cast<const TMsg*>(static_cast<const OwnedMessage*>(var.constData())->message.get());
+    } else {
+        Q_ASSERT(var.userType() == qMetaTypeId<TMsg>());
+        return *static_cast<const TMsg*>(var.constData());
+    }
+}
+
+// 取走载荷内的消息：载荷仍被其他投递共享时 data() 先分离出副本，独占时直接移动。
+// 调用方保证 var 属于本次投递（排队任务持有的副本，或同步投递时的临时副本）。
+// 仅可移动的消息只有一个消费者，直接从共享指针中移出；
+// 内联小消息可平凡复制，“移动”不会改动原字节。
+template<typename TMsg>
+TMsg&& takeMessage(const QVariant& var) {
+    if constexpr (isMoveOnly<TMsg>() || isInline<TMsg>()) {
+        return std::move(const_cast<TMsg&>(messageRef<TMsg>(var)));
+    } else {
+        Q_ASSERT(var.userType() == qMetaTypeId<TMsg>());
+        return std::move(*static_cast<TMsg*>(const_cast<QVariant&>(var).data()));
+    }
+}
+
+// 以 shared_ptr 持有载荷（别名构造，不复制消息）
+template<typename TMsg>
+std::shared_ptr<const TMsg> sharedMessage(const QVariant& var) {
+    if constexpr (isMoveOnly<TMsg>()) {
+        return std::static_pointer_cast<const TMsg>(messageRef<OwnedMessage>(var).message);
+    } else if constexpr (isInline<TMsg>()) {
+        // 内联字节只在本次投递期间有效，保留时复制一份
+        return std::make_shared<const TMsg>(messageRef<TMsg>(var));
+    } else {
+        auto holder = std::make_shared<QVariant>(var);
+        return std::shared_ptr<const TMsg>(holder, &messageRef<TMsg>(*holder));
+    }
+}
+
+// 按处理函数签名选择最便宜的投递方式：
+// const T& 直接引用载荷；T&& 独占时移动；shared_ptr<const T> 共享载荷；MessageSpan<const T> 接收批量
+template<typename TMsg, typename F>
+QVariant invokeHandler(const F& handler, const QVariant& var, const MessageEnvelope& envelope) {
+    if constexpr (accepts<F, const TMsg&>()) {
+        return callWith(handler, messageRef<TMsg>(var), envelope);
+    } else if constexpr (accepts<F, TMsg&&>()) {
+        if constexpr (isInline<TMsg>()) {
+            // 同步投递时内联字节由所有接收者共享，右值处理函数拿到栈上副本
+            TMsg copy = messageRef<TMsg>(var);
+            return callWith(handler, std::move(copy), envelope);
+        } else {
+            return callWith(handler, takeMessage<TMsg>(var), envelope);
+        }
+    } else if constexpr (takesSpan<TMsg, F>()) {
+        if (var.userType() != qMetaTypeId<PayloadBatch>()) {
+            return callWith(handler, MessageSpan<const TMsg>(&messageRef<TMsg>(var), 1), envelope);
+        }
+        const auto& batch = messageRef<PayloadBatch>(var);
+        std::vector<TMsg> messages;
+        messages.reserve(batch.items.size());
+        for (const QVariant& item : batch.items) messages.push_back(takeMessage<TMsg>(item));
+        return callWith(handler, MessageSpan<const TMsg>(messages.data(), messages.size()), envelope);
+    } else {
+        static_assert(accepts<F, std::shared_ptr<const TMsg>>(),
+                      "handler must accept const T&, T&&, std::shared_ptr<const T> or MessageSpan<const T>");
+        return callWith(handler, sharedMessage<TMsg>(var), envelope);
+    }
+}
+
+// 是否可通过 QDataStream 序列化（同时存在 << 与 >>）
+template<typename T, typename = void>
+struct HasDataStreamOperators : std::false_type {};
+
+template<typename T>
+struct HasDataStreamOperators<T, std::void_t<
+    decltype(std::declval<QDataStream&>() << std::declval<const T&>()),
+    decltype(std::declval<QDataStream&>() >> std::declval<T&>())>> : std::true_type {};
+
+// shared_ptr 接收者重载排除执行器本身（执行器走无接收者的执行器重载）
+template<typename T>
+using EnableIfNotExecutor = std::enable_if_t<!std::is_base_of<MessageExecutor, T>::value, int>;
+}
+
+Q_DECLARE_METATYPE(MessengerDetail::PayloadBatch)
+Q_DECLARE_METATYPE(MessengerDetail::OwnedMessage)
+Q_DECLARE_TYPEINFO(MessengerDetail::InlineMessage, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(MessengerDetail::InlineMessage)
+
+namespace MessengerDetail {
+inline const InlineBytes* inlineBytes(const QVariant& var) {
+    if (var.userType() != qMetaTypeId<InlineMessage>()) return nullptr;
+    return static_cast<const InlineMessage*>(var.constData())->bytes;
+}
+
+template<typename TMsg>
+struct SendPayload<TMsg, true> {
+    InlineBytes bytes;
+    QVariant variant;
+    explicit SendPayload(const TMsg& message) {
+        std::memcpy(bytes.data, &message, sizeof(TMsg));
+        variant.setValue(InlineMessage{&bytes});
+    }
+    Q_DISABLE_COPY_MOVE(SendPayload)
+};
+}
+
 
 class MESSAGING_API Messenger {
 public:
     static Messenger& Default();
 
+    // 总线工作线程池：Actor 邮箱等在此调度
+    static QThreadPool* WorkerPool();
+
     // ----------------------------------------------------------
     // Register: 成员函数
     // ----------------------------------------------------------
@@ -48,78 +440,623 @@ public:
         }, token);
     }
 
+    // 成员函数同时接收信封
+    template<typename TMsg, typename TReceiver>
+    void Register(TReceiver* receiver, void (TReceiver::*method)(const TMsg&, const MessageEnvelope&), const MessageToken& token = MessageToken()) {
+        Register<TMsg>(receiver, [receiver, method](const TMsg& msg, const MessageEnvelope& envelope) {
+            (receiver->*method)(msg, envelope);
+        }, token);
+    }
+
     // ----------------------------------------------------------
     // Register: lambda / std::function
     // ----------------------------------------------------------
     template<typename TMsg, typename TFunc>
     void Register(QObject* receiver, TFunc&& callback, const MessageToken& token = MessageToken()) {
-        auto wrapper = [callback = std::forward<TFunc>(callback)](const QVariant& var) {
-            callback(var.value<TMsg>());
-        };
-        internalRegister(typeid(TMsg).hash_code(), token, receiver, std::move(wrapper));
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            constexpr int flags = MessengerDetail::handlerFlags<TMsg, std::decay_t<TFunc>>();
+            auto wrapper = [callback = std::forward<TFunc>(callback)](const QVariant& var, const MessageEnvelope& envelope) {
+                return MessengerDetail::invokeHandler<TMsg>(callback, var, envelope);
+            };
+            internalRegister(typeKey<TMsg>(), token, receiver, std::move(wrapper), nullptr, flags);
+        }
+    }
+
+    // ----------------------------------------------------------
+    // Register: 指定执行器（回调在 executor 中运行，receiver 仅用于生命周期跟踪与注销）
+    // ----------------------------------------------------------
+    template<typename TMsg, typename TReceiver>
+    void Register(TReceiver* receiver, void (TReceiver::*method)(const TMsg&), std::shared_ptr<MessageExecutor> executor, const MessageToken& token = MessageToken()) {
+        Register<TMsg>(receiver, [receiver, method](const TMsg& msg) {
+            (receiver->*method)(msg);
+        }, std::move(executor), token);
+    }
+
+    template<typename TMsg, typename TFunc>
+    void Register(QObject* receiver, TFunc&& callback, std::shared_ptr<MessageExecutor> executor, const MessageToken& token = MessageToken()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            constexpr int flags = MessengerDetail::handlerFlags<TMsg, std::decay_t<TFunc>>();
+            auto wrapper = [callback = std::forward<TFunc>(callback)](const QVariant& var, const MessageEnvelope& envelope) {
+                return MessengerDetail::invokeHandler<TMsg>(callback, var, envelope);
+            };
+            internalRegister(typeKey<TMsg>(), token, receiver, std::move(wrapper), std::move(executor), flags);
+        }
+    }
+
+    // 无接收者：订阅持有执行器，直到 Unregister(executor)
+    template<typename TMsg, typename TFunc>
+    void Register(const std::shared_ptr<MessageExecutor>& executor, TFunc&& callback, const MessageToken& token = MessageToken()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            constexpr int flags = MessengerDetail::handlerFlags<TMsg, std::decay_t<TFunc>>();
+            auto wrapper = [callback = std::forward<TFunc>(callback)](const QVariant& var, const MessageEnvelope& envelope) {
+                return MessengerDetail::invokeHandler<TMsg>(callback, var, envelope);
+            };
+            internalRegister(typeKey<TMsg>(), token, std::weak_ptr<const void>(executor), executor.get(), std::move(wrapper), executor, flags);
+        }
+    }
+
+    // ----------------------------------------------------------
+    // Register: Actor（非 QObject，消息进入 Actor 邮箱，在工作线程池中串行执行）
+    // ----------------------------------------------------------
+    template<typename TMsg, typename TFunc>
+    void Register(MessageActor* actor, TFunc&& callback, const MessageToken& token = MessageToken()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            constexpr int flags = MessengerDetail::handlerFlags<TMsg, std::decay_t<TFunc>>();
+            auto wrapper = [callback = std::forward<TFunc>(callback)](const QVariant& var, const MessageEnvelope& envelope) {
+                return MessengerDetail::invokeHandler<TMsg>(callback, var, envelope);
+            };
+            internalRegister(typeKey<TMsg>(), token, actor, std::move(wrapper), flags);
+        }
+    }
+
+    // ----------------------------------------------------------
+    // Register: shared_ptr 管理的非 QObject 接收者（以 weak_ptr 跟踪）
+    // 投递时 lock：接收者已释放则跳过，否则在回调期间保持存活。
+    // 回调在发送线程中直接执行，接收者需自行保证线程安全。
+    // ----------------------------------------------------------
+    template<typename TMsg, typename T>
+    void Register(const std::weak_ptr<T>& receiver, void (T::*method)(const TMsg&), const MessageToken& token = MessageToken()) {
+        Register<TMsg>(receiver, method, std::shared_ptr<MessageExecutor>(), token);
+    }
+
+    template<typename TMsg, typename T, MessengerDetail::EnableIfNotExecutor<T> = 0>
+    void Register(const std::shared_ptr<T>& receiver, void (T::*method)(const TMsg&), const MessageToken& token = MessageToken()) {
+        Register<TMsg>(std::weak_ptr<T>(receiver), method, token);
+    }
+
+    template<typename TMsg, typename T, typename TFunc>
+    void Register(const std::weak_ptr<T>& receiver, TFunc&& callback, const MessageToken& token = MessageToken()) {
+        Register<TMsg>(receiver, std::forward<TFunc>(callback), std::shared_ptr<MessageExecutor>(), token);
+    }
+
+    template<typename TMsg, typename T, typename TFunc, MessengerDetail::EnableIfNotExecutor<T> = 0>
+    void Register(const std::shared_ptr<T>& receiver, TFunc&& callback, const MessageToken& token = MessageToken()) {
+        Register<TMsg>(std::weak_ptr<T>(receiver), std::forward<TFunc>(callback), token);
+    }
+
+    // shared_ptr 接收者 + 执行器（executor 为空时在发送线程执行）
+    template<typename TMsg, typename T>
+    void Register(const std::weak_ptr<T>& receiver, void (T::*method)(const TMsg&), std::shared_ptr<MessageExecutor> executor, const MessageToken& token = MessageToken()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            auto wrapper = [receiver, method](const QVariant& var, const MessageEnvelope&) {
+                if (auto self = receiver.lock()) {
+                    ((*self).*method)(MessengerDetail::messageRef<TMsg>(var));
+                }
+                return QVariant();
+            };
+            internalRegister(typeKey<TMsg>(), token, std::weak_ptr<const void>(receiver), receiver.lock().get(), std::move(wrapper), std::move(executor));
+        }
+    }
+
+    template<typename TMsg, typename T>
+    void Register(const std::shared_ptr<T>& receiver, void (T::*method)(const TMsg&), std::shared_ptr<MessageExecutor> executor, const MessageToken& token = MessageToken()) {
+        Register<TMsg>(std::weak_ptr<T>(receiver), method, std::move(executor), token);
+    }
+
+    template<typename TMsg, typename T, typename TFunc>
+    void Register(const std::weak_ptr<T>& receiver, TFunc&& callback, std::shared_ptr<MessageExecutor> executor, const MessageToken& token = MessageToken()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            constexpr int flags = MessengerDetail::handlerFlags<TMsg, std::decay_t<TFunc>>();
+            auto wrapper = [receiver, callback = std::forward<TFunc>(callback)](const QVariant& var, const MessageEnvelope& envelope) {
+                if (auto self = receiver.lock()) {
+                    return MessengerDetail::invokeHandler<TMsg>(callback, var, envelope);
+                }
+                return QVariant();
+            };
+            internalRegister(typeKey<TMsg>(), token, std::weak_ptr<const void>(receiver), receiver.lock().get(), std::move(wrapper), std::move(executor), flags);
+        }
+    }
+
+    template<typename TMsg, typename T, typename TFunc>
+    void Register(const std::shared_ptr<T>& receiver, TFunc&& callback, std::shared_ptr<MessageExecutor> executor, const MessageToken& token = MessageToken()) {
+        Register<TMsg>(std::weak_ptr<T>(receiver), std::forward<TFunc>(callback), std::move(executor), token);
     }
 
     // ----------------------------------------------------------
-    // Send
+    // Send（correlationId 为 0 时以本条消息的 sequence 作为关联 ID）
     // ----------------------------------------------------------
     template<typename TMsg>
-    void Send(const TMsg& message, const MessageToken& token = MessageToken()) {
-        QVariant payload;
-        payload.setValue(message);
-        internalSend(typeid(TMsg).hash_code(), token, payload);
+    SendResult Send(const TMsg& message, const MessageToken& token = MessageToken(), quint64 correlationId = 0) {
+        static_assert(!MessengerDetail::isMoveOnly<TMsg>(), "move-only messages must be sent as rvalues: Send<T>(std::move(message))");
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            if (dedupTypes.load(std::memory_order_acquire) != 0 &&
+                !internalAcceptDedup(typeid(TMsg).hash_code(), &message)) {
+                return SendResult::Ok;
+            }
+            // 小的可平凡复制消息内联存储，发送路径不分配（见 MessengerDetail::InlineCapacity）
+            const MessengerDetail::SendPayload<TMsg> payload(message);
+            return internalSend(typeKey<TMsg>(), token, payload.variant, correlationId) ? SendResult::Ok : SendResult::WouldBlock;
+        } else {
+            Q_UNUSED(message)
+            Q_UNUSED(token)
+            Q_UNUSED(correlationId)
+            return SendResult::Ok;
+        }
+    }
+
+    // 右值发送：消息移入载荷，不复制。
+    // 仅可移动的类型（unique_ptr 成员、大缓冲区等）也走这里：载荷保存指向消息的共享指针，
+    // 只投递给按注册顺序第一个匹配且存活的订阅（单消费者），由它以 T&& / 按值取走消息；
+    // 没有匹配的订阅时消息被丢弃。这类类型无需 DECLARE_MESSAGE_TYPE。
+    template<typename TMsg, std::enable_if_t<!std::is_reference<TMsg>::value, int> = 0>
+    SendResult Send(TMsg&& message, const MessageToken& token = MessageToken(), quint64 correlationId = 0) {
+        if constexpr (MessengerDetail::isInline<TMsg>()) {
+            // 可平凡复制：移动即复制，走内联路径
+            return Send<TMsg>(static_cast<const TMsg&>(message), token, correlationId);
+        } else if constexpr (MessageTypeEnabled<TMsg>::value) {
+            if (dedupTypes.load(std::memory_order_acquire) != 0 &&
+                !internalAcceptDedup(typeid(TMsg).hash_code(), &message)) {
+                return SendResult::Ok;
+            }
+            QVariant payload;
+            if constexpr (MessengerDetail::isMoveOnly<TMsg>()) {
+                payload.setValue(MessengerDetail::OwnedMessage{std::make_shared<TMsg>(std::move(message))});
+            } else if constexpr (std::is_default_constructible<TMsg>::value && std::is_move_assignable<TMsg>::value) {
+                payload = QVariant(qMetaTypeId<TMsg>(), nullptr);
+                *static_cast<TMsg*>(payload.data()) = std::move(message);
+            } else {
+                payload.setValue(message);
+            }
+            return internalSend(typeKey<TMsg>(), token, payload, correlationId, true) ? SendResult::Ok : SendResult::WouldBlock;
+        } else {
+            Q_UNUSED(message)
+            Q_UNUSED(token)
+            Q_UNUSED(correlationId)
+            return SendResult::Ok;
+        }
+    }
+
+    // ----------------------------------------------------------
+    // 并行发送：线程无关的处理函数（shared_ptr 接收者且未指定执行器）提交到 WorkerPool() 并行执行，
+    // 返回它们全部完成时结束的 QFuture；其余接收者照常按线程语义分发，不计入 QFuture。
+    // SendParallel<TMsg, R> 收集返回 R 的处理函数结果（其他处理函数只等待、不提供结果）。
+    // 被去重丢弃或被流控拒绝时不投递，返回已结束且没有结果的 QFuture。
+    // ----------------------------------------------------------
+    template<typename TMsg, typename R = void>
+    QFuture<R> SendParallel(const TMsg& message, const MessageToken& token = MessageToken()) {
+        static_assert(!MessengerDetail::isMoveOnly<TMsg>(), "SendParallel cannot deliver move-only messages: parallel handlers share one payload; use Send<T>(std::move(message))");
+        QFutureInterface<R> future;
+        future.reportStarted();
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            if (dedupTypes.load(std::memory_order_acquire) != 0 &&
+                !internalAcceptDedup(typeid(TMsg).hash_code(), &message)) {
+                future.reportFinished();
+                return future.future();
+            }
+            QVariant payload;
+            payload.setValue(message);
+            internalSendParallel(typeKey<TMsg>(), token, payload, [future](const QVariant& result) mutable {
+                if constexpr (!std::is_void<R>::value) {
+                    if (result.userType() == qMetaTypeId<R>()) future.reportResult(result.value<R>());
+                } else {
+                    Q_UNUSED(result)
+                }
+            }, [future]() mutable {
+                future.reportFinished();
+            });
+        } else {
+            Q_UNUSED(message)
+            Q_UNUSED(token)
+            future.reportFinished();
+        }
+        return future.future();
+    }
+
+    // 延迟构造：仅在类型启用时调用 factory() 生成消息，
+    // 禁用类型的参数构造（字符串格式化等）在编译期整体消除
+    template<typename TMsg, typename TFactory>
+    SendResult SendWith(TFactory&& factory, const MessageToken& token = MessageToken()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            return Send<TMsg>(std::forward<TFactory>(factory)(), token);
+        } else {
+            Q_UNUSED(factory)
+            Q_UNUSED(token)
+            return SendResult::Ok;
+        }
+    }
+
+    // ----------------------------------------------------------
+    // 信用额度流控（按接收者）：每次排队投递占用一个额度，处理函数返回后归还。
+    // 额度耗尽时按策略阻塞 / 返回 WouldBlock / 回调生产者；多个受控接收者时
+    // 全有或全无：任一接收者额度不足，整条消息都不投递。
+    // 与发送线程同线程的 QObject 接收者同步执行，不占用额度，也不会阻塞。
+    // Unregister(receiver) 同时移除其流控配置；QObject 接收者析构时自动移除。
+    // ----------------------------------------------------------
+    void EnableFlowControl(QObject* receiver, const FlowControlOptions& options = FlowControlOptions());
+    void EnableFlowControl(MessageActor* actor, const FlowControlOptions& options = FlowControlOptions());
+    void DisableFlowControl(QObject* receiver);
+    void DisableFlowControl(MessageActor* actor);
+    // 剩余额度（未启用流控时返回 -1）
+    int AvailableCredits(QObject* receiver) const;
+    int AvailableCredits(MessageActor* actor) const;
+
+    // ----------------------------------------------------------
+    // 投递优先级（按类型）：只影响经线程分发器排队的投递（含 MessageExecutor::Thread），
+    // 同步执行、actor 与其他执行器接收者不受影响
+    // ----------------------------------------------------------
+    // 禁用类型不登记类型键，SetPriority 为空操作，Priority 恒为 Normal
+    template<typename TMsg>
+    void SetPriority(MessagePriority priority) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            internalSetPriority(typeKey<TMsg>(), priority);
+        } else {
+            Q_UNUSED(priority)
+        }
+    }
+
+    template<typename TMsg>
+    MessagePriority Priority() {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            return internalPriority(typeKey<TMsg>());
+        } else {
+            return MessagePriority::Normal;
+        }
+    }
+
+    // ----------------------------------------------------------
+    // 大扇出：匹配订阅数达到 threshold 时，跨线程 / actor / 执行器的排队投递按 chunkSize 分块，
+    // 由发送线程与 WorkerPool() 协同完成（fork-join），Send 返回前全部排队完毕，
+    // 每个接收者收到的顺序与发送顺序一致。同步执行的接收者仍在发送线程中调用。
+    // ----------------------------------------------------------
+    void SetFanoutOptions(const FanoutOptions& options);
+    FanoutOptions Fanout() const;
+
+    // ----------------------------------------------------------
+    // 发送暂存（按线程开启）：开启后本线程的 Send 只追加到线程局部暂存区并返回 Ok，
+    // 在本轮事件循环处理完已排队事件后（低优先级事件）或显式 Flush() 时按发送顺序统一发送。
+    // 批内共用一次订阅快照，连续同类型消息只匹配一次，
+    // 每个目标线程分发器只加锁、唤醒一次。
+    // 流控在 Flush 时生效：额度不足的消息被丢弃（Callback 策略仍会回调），
+    // Block 策略在刷新时按 WouldBlock 处理，不会阻塞刷新线程；Flush() 返回被丢弃的条数。没有事件循环的线程需要自行调用 Flush()。
+    // 关闭暂存时先发送已暂存的消息。
+    // ----------------------------------------------------------
+    void SetSendStaging(bool enabled);
+    bool SendStaging() const;
+    int Flush();
+
+    // ----------------------------------------------------------
+    // 发布组：整组消息一次发布。排队投递的接收者在一次排空中连续处理本组消息，
+    // 不会与其他发送交错；组内共享关联 ID（未指定时取首条消息的 sequence）。
+    // 流控对整组全有或全无：任一投递额度不足，整组都不投递；Block 策略只在未持有额度时等待，
+    // 整组对同一接收者的投递数超过其额度总数时直接返回 WouldBlock。
+    // 同线程接收者按组内顺序同步执行。整个过程不持有全局锁。
+    // ----------------------------------------------------------
+    SendResult Publish(const PublishGroup& group, quint64 correlationId = 0);
+
+    // ----------------------------------------------------------
+    // 去重（按类型启用）：发送前按 ID 查最近窗口，重复消息在扇出前丢弃
+    // ----------------------------------------------------------
+    template<typename TMsg, typename TIdFunc>
+    void EnableDeduplication(TIdFunc&& idOf, const DedupOptions& options = DedupOptions()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            internalEnableDedup(typeid(TMsg).hash_code(), [idOf = std::forward<TIdFunc>(idOf)](const void* msg) {
+                return MessengerDetail::dedupKey(idOf(*static_cast<const TMsg*>(msg)));
+            }, options);
+        } else {
+            Q_UNUSED(idOf)
+            Q_UNUSED(options)
+        }
+    }
+
+    template<typename TMsg>
+    void DisableDeduplication() {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            internalDisableDedup(typeid(TMsg).hash_code());
+        }
+    }
+
+    // 已丢弃的重复消息数
+    template<typename TMsg>
+    quint64 DuplicatesDropped() {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            return internalDuplicatesDropped(typeid(TMsg).hash_code());
+        } else {
+            return 0;
+        }
     }
 
     // ----------------------------------------------------------
     // Unregister（全部 / 按类型 / 按 Token）
     // ----------------------------------------------------------
     void Unregister(QObject* receiver);
+    void Unregister(MessageActor* actor);
 
+    // 禁用类型没有订阅，按类型注销为空操作
     template<typename TMsg>
     void Unregister(QObject* receiver, const MessageToken& token = MessageToken()) {
-        quint64 type = typeid(TMsg).hash_code();
-        for (auto it = subscriptions.begin(); it != subscriptions.end(); ) {
-            if (it->receiver.data() == receiver && it->type == type &&
-                (token.isEmpty() || it->token == token)) {
-                it = subscriptions.erase(it);
-            } else {
-                ++it;
-            }
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            internalUnregister(receiver, typeid(TMsg).hash_code(), token);
+        } else {
+            Q_UNUSED(receiver)
+            Q_UNUSED(token)
+        }
+    }
+
+    template<typename TMsg>
+    void Unregister(MessageActor* actor, const MessageToken& token = MessageToken()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            internalUnregister(actor, typeid(TMsg).hash_code(), token);
+        } else {
+            Q_UNUSED(actor)
+            Q_UNUSED(token)
+        }
+    }
+
+    template<typename T>
+    void Unregister(const std::shared_ptr<T>& receiver) {
+        if (receiver) internalUnregister(receiver.get());
+    }
+
+    template<typename TMsg, typename T>
+    void Unregister(const std::shared_ptr<T>& receiver, const MessageToken& token = MessageToken()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            if (receiver) internalUnregister(receiver.get(), typeid(TMsg).hash_code(), token);
+        } else {
+            Q_UNUSED(receiver)
+            Q_UNUSED(token)
         }
     }
 
     // ----------------------------------------------------------
-    // Cleanup（可选：清理已析构的弱引用）
+    // Cleanup（可选：清理已析构的弱引用，以及未注销就析构的接收者的流控额度）
     // ----------------------------------------------------------
     void Cleanup();
 
+    // ----------------------------------------------------------
+    // 订阅表诊断：以 JSON 导出当前订阅快照
+    // （类型名、Token、接收者类名/对象名/线程、分发方式、计数器），
+    // 基于写时复制快照生成，不阻塞并发发送。
+    // ----------------------------------------------------------
+    QByteArray DumpSubscriptions(bool indented = true) const;
+
+    // ----------------------------------------------------------
+    // 类型注册表：名字、sizeof、是否可平凡复制、是否可序列化
+    // 未登记的类型返回 id 为 0 的空信息；查询无锁
+    // ----------------------------------------------------------
+    MessageTypeInfo TypeInfo(quint64 type) const;
+    QList<MessageTypeInfo> Types() const;
+
+    // 禁用类型不登记，返回 id 为 0 的空信息
+    template<typename TMsg>
+    MessageTypeInfo TypeInfo() {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            return TypeInfo(typeKey<TMsg>());
+        } else {
+            return MessageTypeInfo();
+        }
+    }
+
+    // ----------------------------------------------------------
+    // 因果追踪
+    // ----------------------------------------------------------
+    // 当前线程正在处理的消息信封（不在总线处理函数中时为 nullptr）
+    static const MessageEnvelope* CurrentEnvelope();
+
+    // 设置追踪器（nullptr 关闭）；未设置时发送路径只多一次原子读
+    void SetTracer(std::shared_ptr<MessageTracer> tracer);
+
+    // 订阅统计快照（与 DumpSubscriptions 同源）
+    QList<SubscriptionStats> Stats() const;
+
+    // 是否记录投递延迟（需要在发送时取时间戳，默认关闭；指标导出器启动时打开）
+    void SetLatencyTracking(bool enabled);
+    bool LatencyTracking() const { return latencyTracking.load(std::memory_order_relaxed); }
+
 private:
+    using Handler = std::function<QVariant(const QVariant&, const MessageEnvelope&)>;  // 返回处理函数的结果（无结果时为空）
+
+    struct DeliveryBatch;
     struct Subscription {
-        quint64 type;
+        quint64 id = 0;
+        quint64 type = 0;
         MessageToken token;
         QPointer<QObject> receiver;  // 弱引用
-        std::function<void(const QVariant&)> callback;
+        Handler callback;
+        MessageActor* actor = nullptr;  // 非空时投递到 Actor 邮箱（Actor 析构时自行注销）
+        std::shared_ptr<MessageMailbox> mailbox;  // Actor 的邮箱：Actor 关闭后仍有效，旧快照的投递在此被丢弃
+        std::weak_ptr<const void> tracked;  // shared_ptr 接收者的弱引用
+        const void* trackedKey = nullptr;   // shared_ptr 接收者的身份，用于注销
+        std::shared_ptr<MessageExecutor> executor;  // 非空时回调交由执行器运行
+        bool consumes = false;                      // 处理函数以右值接收消息：同步投递时传入载荷副本
+        std::shared_ptr<DeliveryBatch> coalesce;    // 批量处理函数：跨线程投递在订阅内合批
+
+        mutable std::atomic<quint64> matched{0};    // 匹配到本订阅的消息数
+        mutable std::atomic<quint64> delivered{0};  // 实际执行回调的次数
+        mutable std::atomic<quint64> pending{0};    // 已排队（跨线程 / 邮箱 / 执行器）尚未执行
+        mutable LatencyHistogram latency;
+
+        bool mailboxClosed() const;
+        const void* owner() const {
+            if (actor) return actor;
+            if (trackedKey) return trackedKey;
+            return receiver.data();
+        }
+        bool isAlive() const {
+            if (actor) return !mailboxClosed();
+            if (trackedKey) return !tracked.expired();
+            return !receiver.isNull();
+        }
     };
 
-    QList<Subscription> subscriptions;
+    using SubscriptionPtr = std::shared_ptr<const Subscription>;
+    using SubscriptionList = QList<SubscriptionPtr>;
+
+    // 写时复制：注册/注销在 writeMutex 下生成新表并原子替换，发送方只读取快照
+    std::shared_ptr<const SubscriptionList> subscriptions = std::make_shared<const SubscriptionList>();
+    mutable QMutex writeMutex;
+    quint64 nextSubscriptionId = 1;
+    // 类型注册表：写时复制，与订阅表共用 writeMutex
+    using TypeTable = QHash<quint64, MessageTypeInfo>;
+    std::shared_ptr<const TypeTable> types = std::make_shared<const TypeTable>();
+    std::atomic<bool> latencyTracking{false};
+    std::atomic<quint64> nextSequence{1};
+    std::shared_ptr<MessageTracer> tracer;  // 以 atomic_load/atomic_store 访问
+    std::atomic<bool> tracing{false};
+
+    struct FlowGate;
+    using FlowTable = QHash<const void*, std::shared_ptr<FlowGate>>;
+    std::shared_ptr<const FlowTable> flowGates = std::make_shared<const FlowTable>();  // 写时复制
+    std::atomic<int> flowReceivers{0};  // 启用流控的接收者数；为 0 时 Send 跳过额度检查
+    // 按地址查找额度；QObject 接收者已析构（地址可能被新对象复用）时视为未启用
+    static std::shared_ptr<FlowGate> liveGate(const FlowTable& gates, const void* owner);
+
+    // 非默认优先级的类型：写时复制，与订阅表共用 writeMutex
+    using PriorityTable = QHash<quint64, MessagePriority>;
+    std::shared_ptr<const PriorityTable> priorities = std::make_shared<const PriorityTable>();
+    std::atomic<int> prioritizedTypes{0};  // 为 0 时 Send 跳过查表
+    std::atomic<int> fanoutThreshold{FanoutOptions().threshold};
+    std::atomic<int> fanoutChunk{FanoutOptions().chunkSize};
+
+    // 启用去重的类型：写时复制，与订阅表共用 writeMutex；Send 只锁命中类型自己的窗口
+    struct DedupStage;
+    using DedupTable = QHash<quint64, std::shared_ptr<DedupStage>>;
+    std::shared_ptr<const DedupTable> dedupStages = std::make_shared<const DedupTable>();
+    std::atomic<int> dedupTypes{0};  // 启用去重的类型数；为 0 时 Send 跳过检查
 
     Messenger() = default;
     Q_DISABLE_COPY_MOVE(Messenger)
 
-    void internalRegister(quint64 type, const MessageToken& token, QObject* receiver, std::function<void(const QVariant&)>&& cb);
+    // 类型键；首次 Register/Send 该类型时注册元类型并登记到类型注册表。
+    // 函数内静态量由编译器保证线程安全且只初始化一次，之后仅剩一次已初始化检查。
+    template<typename TMsg>
+    quint64 typeKey() {
+        static const quint64 type = [this] {
+            MessageTypeInfo info;
+            info.id = typeid(TMsg).hash_code();
+            if constexpr (MessengerDetail::isMoveOnly<TMsg>()) {
+                info.metaTypeId = qRegisterMetaType<MessengerDetail::OwnedMessage>();
+                info.name = MoveOnlyMessageName<TMsg>::value();
+                info.moveOnly = true;
+            } else {
+                info.metaTypeId = qRegisterMetaType<TMsg>();
+                info.name = QMetaType::typeName(info.metaTypeId);
+                info.serializable = MessengerDetail::HasDataStreamOperators<TMsg>::value;
+            }
+            info.size = int(sizeof(TMsg));
+            info.triviallyCopyable = std::is_trivially_copyable<TMsg>::value;
+            registerType(info);
+            return info.id;
+        }();
+        return type;
+    }
+    void registerType(const MessageTypeInfo& info);
+
+    std::shared_ptr<const SubscriptionList> snapshot() const;
+    void addSubscription(std::shared_ptr<Subscription>&& sub);
+    void removeSubscriptions(const std::function<bool(const Subscription&)>& match);
+
+    // flags：MessengerDetail::HandlerFlag
+    void internalRegister(quint64 type, const MessageToken& token, QObject* receiver, Handler&& cb,
+                          std::shared_ptr<MessageExecutor> executor = nullptr, int flags = 0);
+    void internalRegister(quint64 type, const MessageToken& token, MessageActor* actor, Handler&& cb, int flags = 0);
+    void internalRegister(quint64 type, const MessageToken& token, std::weak_ptr<const void>&& tracked, const void* key, Handler&& cb,
+                          std::shared_ptr<MessageExecutor> executor = nullptr, int flags = 0);
+    void internalUnregister(const void* owner);
+    void internalUnregister(const void* owner, quint64 type, const MessageToken& token);
+
+    struct SendBatch;
+    // owned：载荷由本次右值 Send 独占（发送返回后不再使用），唯一的右值处理函数可以直接取走
+    bool internalSend(quint64 type, const MessageToken& token, const QVariant& payload, quint64 correlationId, bool owned = false);
+    bool dispatchSend(quint64 type, const MessageToken& token, const QVariant& payload, quint64 correlationId, SendBatch* batch, bool owned = false);
+    void internalSendParallel(quint64 type, const MessageToken& token, const QVariant& payload,
+                              std::function<void(const QVariant&)>&& onResult, std::function<void()>&& onFinished);
+
+    void internalEnableFlow(const void* owner, const FlowControlOptions& options, QObject* receiver = nullptr);
+    void internalDisableFlow(const void* owner);
+    int internalAvailableCredits(const void* owner) const;
+    void internalSetPriority(quint64 type, MessagePriority priority);
+    MessagePriority internalPriority(quint64 type) const;
 
-    void internalSend(quint64 type, const MessageToken& token, const QVariant& payload);
+    void internalEnableDedup(quint64 type, std::function<quint64(const void*)>&& idOf, const DedupOptions& options);
+    void internalDisableDedup(quint64 type);
+    bool internalAcceptDedup(quint64 type, const void* message);
+    quint64 internalDuplicatesDropped(quint64 type);
+
+    friend class PublishGroup;
 };
 
 // ──────────────────────────────────────────────────────────────
-// 自动注册元类型（宏）
+// 发布组：收集一组相关消息，交给 Messenger::Publish 整体发布
+// Add 时即完成去重检查与类型登记；禁用类型的 Add 为空操作。
 // ──────────────────────────────────────────────────────────────
-#define DECLARE_MESSAGE_TYPE(T) \
-    Q_DECLARE_METATYPE(T) \
-    namespace { \
-        struct __Register_##T { \
-            __Register_##T() { \
-                qRegisterMetaType<T>(#T); \
-            } \
-        }; \
-        static __Register_##T __reg_##T; \
+class MESSAGING_API PublishGroup {
+public:
+    template<typename TMsg>
+    PublishGroup& Add(const TMsg& message, const MessageToken& token = MessageToken()) {
+        static_assert(!MessengerDetail::isMoveOnly<TMsg>(), "PublishGroup cannot hold move-only messages: send them individually with Send<T>(std::move(message))");
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            Messenger& bus = Messenger::Default();
+            if (bus.dedupTypes.load(std::memory_order_acquire) != 0 &&
+                !bus.internalAcceptDedup(typeid(TMsg).hash_code(), &message)) {
+                return *this;
+            }
+            QVariant payload;
+            payload.setValue(message);
+            entries.append({bus.typeKey<TMsg>(), token, payload});
+        } else {
+            Q_UNUSED(message)
+            Q_UNUSED(token)
+        }
+        return *this;
     }
+
+    int size() const { return entries.size(); }
+    bool isEmpty() const { return entries.isEmpty(); }
+    void clear() { entries.clear(); }
+
+private:
+    friend class Messenger;
+    struct Entry {
+        quint64 type = 0;
+        MessageToken token;
+        QVariant payload;
+    };
+    QList<Entry> entries;
+};
+
+// ──────────────────────────────────────────────────────────────
+// 声明消息类型（宏）
+// 仅声明元类型，不产生静态初始化对象：qRegisterMetaType 延迟到该类型
+// 首次 Register/Send 时执行（见 Messenger::typeKey），未使用的类型没有启动开销。
+// 如需在总线之外按名字使用元类型（如排队信号），请自行调用 qRegisterMetaType<T>()。
+// ──────────────────────────────────────────────────────────────
+#define DECLARE_MESSAGE_TYPE(T) \
+    Q_DECLARE_METATYPE(T)
+
+// 将类型标记为本构建禁用（需位于全局命名空间）
+#define DISABLE_MESSAGE_TYPE(T) \
+    template<> struct MessageTypeEnabled<T> : std::false_type {};
+
+// 仅可移动的消息类型：不声明元类型，只登记可读的类型名（需位于全局命名空间）
+#define DECLARE_MOVE_ONLY_MESSAGE_TYPE(T) \
+    template<> struct MoveOnlyMessageName<T> { static const char* value() { return #T; } };
+
+// 仅调试构建启用的消息类型
+#ifdef QT_NO_DEBUG
+#define DECLARE_DEBUG_MESSAGE_TYPE(T) \
+    DECLARE_MESSAGE_TYPE(T) \
+    DISABLE_MESSAGE_TYPE(T)
+#else
+#define DECLARE_DEBUG_MESSAGE_TYPE(T) \
+    DECLARE_MESSAGE_TYPE(T)
+#endif
@@ -1,15 +1,35 @@
-QT += core
-CONFIG += qt c++17 dll
-TEMPLATE = lib
-TARGET = Messenger
-DESTDIR = $$PWD/libs
-
-DEFINES += MESSAGING_LIBRARY
-
-HEADERS += \
-    Messenger.h
-
-SOURCES += \
-    Messenger.cpp
-
-INCLUDEPATH += .
+QT += core network
+CONFIG += qt c++17 dll
+TEMPLATE = lib
+TARGET = Messenger
+DESTDIR = $$PWD/libs
+
+DEFINES += MESSAGING_LIBRARY
+
+# 剖析构建：启用发送/投递路径插桩（见 MessengerHooks.h）；追加 MESSENGER_HOOKS_USDT 使用 USDT 静态探针
+# DEFINES += MESSENGER_ENABLE_HOOKS
+
+HEADERS += \
+    Messenger.h \
+    MessageActor.h \
+    MessageDispatcher.h \
+    MessageExecutor.h \
+    MessageJoin.h \
+    MessageStrand.h \
+    MessageTracer.h \
+    MessengerHooks.h \
+    MessengerMetrics.h \
+    MessengerShards.h \
+    SpscQueue.h
+
+SOURCES += \
+    Messenger.cpp \
+    MessageActor.cpp \
+    MessageDispatcher.cpp \
+    MessageExecutor.cpp \
+    MessageStrand.cpp \
+    MessageTracer.cpp \
+    MessengerMetrics.cpp \
+    MessengerShards.cpp
+
+INCLUDEPATH += .
@@ -0,0 +1,86 @@
+// MessengerHooks.h
+#pragma once
+#include <atomic>
+#include "Messenger.h"
+
+// ──────────────────────────────────────────────────────────────
+// 编译期插桩 Hook
+//
+// 发送/投递路径上的探针点，仅在定义 MESSENGER_ENABLE_HOOKS 时存在；
+// 未定义时 MESSENGER_HOOK(...) 展开为空语句，参数不求值，发布构建零开销。
+//
+// 启用后由 MESSENGER_HOOK_POLICY 选择策略（编译期静态分派，无虚调用）：
+// - 默认：MessengerCallbackHooks，转发给运行时设置的函数指针（未设置时仅一次原子读）
+// - 定义 MESSENGER_HOOKS_USDT：MessengerUsdtHooks，使用 <sys/sdt.h> 静态探针，
+//   未附加 perf/bpftrace 时只是一条 nop；provider 为 "messenger"
+// - 自定义：DEFINES += MESSENGER_HOOK_POLICY=MyHooks MESSENGER_HOOK_POLICY_HEADER=\\\"MyHooks.h\\\"
+//   MyHooks 需提供 template<MessengerHookPoint P> static void hook(quint64 type, quint64 arg)
+//
+// 各探针点的 arg：
+//   BeforeMatch   0                  开始匹配订阅表
+//   AfterMatch    本次匹配到的订阅数   匹配与派发结束
+//   Enqueue       订阅 id            投递任务进入 Actor / 执行器 / 事件队列
+//   Dequeue       订阅 id            投递任务开始执行
+//   HandlerBegin  订阅 id            回调开始
+//   HandlerEnd    订阅 id            回调结束
+//
+// 注意：库内的探针在编译库时决定，需使用相同的 DEFINES 构建 Messenger 库。
+// ──────────────────────────────────────────────────────────────
+enum class MessengerHookPoint {
+    BeforeMatch,
+    AfterMatch,
+    Enqueue,
+    Dequeue,
+    HandlerBegin,
+    HandlerEnd,
+};
+
+using MessengerHookFn = void (*)(MessengerHookPoint point, quint64 type, quint64 arg);
+
+// 运行时回调策略：适合在剖析构建中接入自定义统计
+struct MESSAGING_API MessengerCallbackHooks {
+    static void SetCallback(MessengerHookFn fn);
+
+    template<MessengerHookPoint P>
+    static void hook(quint64 type, quint64 arg) {
+        if (MessengerHookFn fn = callback.load(std::memory_order_acquire)) fn(P, type, arg);
+    }
+
+private:
+    static std::atomic<MessengerHookFn> callback;
+};
+
+#if defined(MESSENGER_HOOKS_USDT)
+#include <sys/sdt.h>
+
+// USDT 策略：探针名需为字面量，按探针点编译期选择
+// 例：bpftrace -e 'usdt:./libMessenger.so:messenger:handler_begin { @[arg0] = count(); }'
+struct MessengerUsdtHooks {
+    template<MessengerHookPoint P>
+    static void hook(quint64 type, quint64 arg) {
+        if constexpr (P == MessengerHookPoint::BeforeMatch) DTRACE_PROBE2(messenger, before_match, type, arg);
+        else if constexpr (P == MessengerHookPoint::AfterMatch) DTRACE_PROBE2(messenger, after_match, type, arg);
+        else if constexpr (P == MessengerHookPoint::Enqueue) DTRACE_PROBE2(messenger, enqueue, type, arg);
+        else if constexpr (P == MessengerHookPoint::Dequeue) DTRACE_PROBE2(messenger, dequeue, type, arg);
+        else if constexpr (P == MessengerHookPoint::HandlerBegin) DTRACE_PROBE2(messenger, handler_begin, type, arg);
+        else DTRACE_PROBE2(messenger, handler_end, type, arg);
+    }
+};
+#endif
+
+#if defined(MESSENGER_ENABLE_HOOKS)
+#  if defined(MESSENGER_HOOK_POLICY_HEADER)
+#    include MESSENGER_HOOK_POLICY_HEADER
+#  endif
+#  if !defined(MESSENGER_HOOK_POLICY)
+#    if defined(MESSENGER_HOOKS_USDT)
+#      define MESSENGER_HOOK_POLICY MessengerUsdtHooks
+#    else
+#      define MESSENGER_HOOK_POLICY MessengerCallbackHooks
+#    endif
+#  endif
+#  define MESSENGER_HOOK(point, type, arg) \
+      MESSENGER_HOOK_POLICY::template hook<MessengerHookPoint::point>(quint64(type), quint64(arg))
+#else
+#  define MESSENGER_HOOK(point, type, arg) ((void)0)
+#endif
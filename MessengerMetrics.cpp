@@ -0,0 +1,213 @@
+#include "MessengerMetrics.h"
+#include "MessageDispatcher.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMap>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QTimer>
+
+namespace {
+
+QByteArray escapeLabel(const QString& value) {
+    QByteArray out;
+    for (char c : value.toUtf8()) {
+        if (c == '\\') out += "\\\\";
+        else if (c == '"') out += "\\\"";
+        else if (c == '\n') out += "\\n";
+        else out += c;
+    }
+    return out;
+}
+
+QByteArray labels(std::initializer_list<std::pair<const char*, QString>> pairs) {
+    QByteArray out = "{";
+    bool first = true;
+    for (const auto& pair : pairs) {
+        if (!first) out += ",";
+        first = false;
+        out += pair.first;
+        out += "=\"";
+        out += escapeLabel(pair.second);
+        out += "\"";
+    }
+    out += "}";
+    return out;
+}
+
+void header(QByteArray& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += " ";
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += " ";
+    out += type;
+    out += "\n";
+}
+
+void sample(QByteArray& out, const QByteArray& name, const QByteArray& labelSet, double value) {
+    out += name;
+    out += labelSet;
+    out += " ";
+    out += QByteArray::number(value, 'g', 17);
+    out += "\n";
+}
+
+struct TypeTokenTotals {
+    quint64 matched = 0;
+    quint64 delivered = 0;
+    quint64 buckets[LatencyHistogram::BucketCount + 1] = {};
+    quint64 latencyCount = 0;
+    quint64 latencySumNs = 0;
+};
+
+}
+
+QByteArray MessengerMetricsExporter::PrometheusText(const Messenger& bus) {
+    const QList<SubscriptionStats> stats = bus.Stats();
+
+    // 按 (type, token) 聚合；QMap 保证输出顺序稳定
+    QMap<QPair<QString, QString>, TypeTokenTotals> totals;
+    QMap<QString, quint64> subscriptionsByType;
+    QMap<QString, quint64> depthByThread;
+    for (const SubscriptionStats& s : stats) {
+        TypeTokenTotals& t = totals[qMakePair(s.type, s.token)];
+        t.matched += s.matched;
+        t.delivered += s.delivered;
+        for (int i = 0; i <= LatencyHistogram::BucketCount; ++i) t.buckets[i] += s.latencyBuckets[i];
+        t.latencyCount += s.latencyCount;
+        t.latencySumNs += s.latencySumNs;
+        subscriptionsByType[s.type] += 1;
+        depthByThread[s.thread.isEmpty() ? QString("inline") : s.thread] += s.pending;
+    }
+
+    QByteArray out;
+    header(out, "messenger_messages_matched_total", "counter", "Messages matched to a subscription.");
+    for (auto it = totals.constBegin(); it != totals.constEnd(); ++it) {
+        sample(out, "messenger_messages_matched_total", labels({{"type", it.key().first}, {"token", it.key().second}}), double(it->matched));
+    }
+    header(out, "messenger_messages_delivered_total", "counter", "Handler invocations.");
+    for (auto it = totals.constBegin(); it != totals.constEnd(); ++it) {
+        sample(out, "messenger_messages_delivered_total", labels({{"type", it.key().first}, {"token", it.key().second}}), double(it->delivered));
+    }
+    header(out, "messenger_delivery_latency_seconds", "histogram", "Time from Send to handler start.");
+    for (auto it = totals.constBegin(); it != totals.constEnd(); ++it) {
+        const QString& type = it.key().first;
+        const QString& token = it.key().second;
+        quint64 cumulative = 0;
+        for (int i = 0; i < LatencyHistogram::BucketCount; ++i) {
+            cumulative += it->buckets[i];
+            const QString le = QString::number(LatencyHistogram::BoundsUs[i] / 1e6, 'g', 6);
+            sample(out, "messenger_delivery_latency_seconds_bucket", labels({{"type", type}, {"token", token}, {"le", le}}), double(cumulative));
+        }
+        cumulative += it->buckets[LatencyHistogram::BucketCount];
+        sample(out, "messenger_delivery_latency_seconds_bucket", labels({{"type", type}, {"token", token}, {"le", "+Inf"}}), double(cumulative));
+        sample(out, "messenger_delivery_latency_seconds_sum", labels({{"type", type}, {"token", token}}), it->latencySumNs / 1e9);
+        sample(out, "messenger_delivery_latency_seconds_count", labels({{"type", type}, {"token", token}}), double(it->latencyCount));
+    }
+    header(out, "messenger_subscriptions", "gauge", "Registered subscriptions.");
+    for (auto it = subscriptionsByType.constBegin(); it != subscriptionsByType.constEnd(); ++it) {
+        sample(out, "messenger_subscriptions", labels({{"type", it.key()}}), double(it.value()));
+    }
+    header(out, "messenger_mailbox_depth", "gauge", "Queued deliveries not yet executed, per target thread.");
+    for (auto it = depthByThread.constBegin(); it != depthByThread.constEnd(); ++it) {
+        sample(out, "messenger_mailbox_depth", labels({{"thread", it.key()}}), double(it.value()));
+    }
+    header(out, "messenger_message_type_info", "gauge", "Registered message types with size and traits.");
+    for (const MessageTypeInfo& info : bus.Types()) {
+        sample(out, "messenger_message_type_info", labels({{"type", QString::fromLatin1(info.name)},
+                                                           {"size", QString::number(info.size)},
+                                                           {"trivially_copyable", info.triviallyCopyable ? "true" : "false"},
+                                                           {"serializable", info.serializable ? "true" : "false"}}), 1);
+    }
+    const QList<DispatchStats> dispatchers = MessageDispatcher::AllStats();
+    header(out, "messenger_dispatch_wakeups_total", "counter", "Wakeups (drains) of per-thread dispatchers.");
+    for (const DispatchStats& d : dispatchers) {
+        sample(out, "messenger_dispatch_wakeups_total", labels({{"thread", d.thread}}), double(d.wakeups));
+    }
+    header(out, "messenger_dispatch_batch_size", "histogram", "Deliveries executed per dispatcher wakeup.");
+    for (const DispatchStats& d : dispatchers) {
+        quint64 cumulative = 0;
+        for (int i = 0; i < DispatchStats::BucketCount; ++i) {
+            cumulative += d.batchBuckets[i];
+            sample(out, "messenger_dispatch_batch_size_bucket", labels({{"thread", d.thread}, {"le", QString::number(DispatchStats::BatchBounds[i])}}), double(cumulative));
+        }
+        cumulative += d.batchBuckets[DispatchStats::BucketCount];
+        sample(out, "messenger_dispatch_batch_size_bucket", labels({{"thread", d.thread}, {"le", "+Inf"}}), double(cumulative));
+        sample(out, "messenger_dispatch_batch_size_sum", labels({{"thread", d.thread}}), double(d.deliveries));
+        sample(out, "messenger_dispatch_batch_size_count", labels({{"thread", d.thread}}), double(d.wakeups));
+    }
+    QThreadPool* pool = Messenger::WorkerPool();
+    header(out, "messenger_pool_active_threads", "gauge", "Active threads in the bus worker pool.");
+    sample(out, "messenger_pool_active_threads", QByteArray(), double(pool->activeThreadCount()));
+    header(out, "messenger_pool_max_threads", "gauge", "Maximum threads in the bus worker pool.");
+    sample(out, "messenger_pool_max_threads", QByteArray(), double(pool->maxThreadCount()));
+    return out;
+}
+
+// 后台线程中的导出逻辑：定时器、文件写入与本地服务都属于该线程
+class MessengerMetricsExporter::Worker : public QObject {
+public:
+    Worker(const MetricsExportOptions& options, Messenger& bus) : options(options), bus(bus) {}
+
+    void start() {
+        timer = new QTimer(this);
+        QObject::connect(timer, &QTimer::timeout, this, [this] { refresh(); });
+        timer->start(options.intervalMs > 0 ? options.intervalMs : 5000);
+
+        if (!options.serverName.isEmpty()) {
+            server = new QLocalServer(this);
+            QLocalServer::removeServer(options.serverName);
+            if (!server->listen(options.serverName)) {
+                qWarning() << "MessengerMetricsExporter: listen failed" << server->errorString();
+            }
+            QObject::connect(server, &QLocalServer::newConnection, this, [this] { serve(); });
+        }
+        refresh();
+    }
+
+private:
+    void refresh() {
+        latest = MessengerMetricsExporter::PrometheusText(bus);
+        if (options.filePath.isEmpty()) return;
+        QSaveFile file(options.filePath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return;
+        file.write(latest);
+        file.commit();
+    }
+
+    void serve() {
+        while (QLocalSocket* socket = server->nextPendingConnection()) {
+            QObject::connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+            socket->write(latest);
+            socket->disconnectFromServer();
+        }
+    }
+
+    MetricsExportOptions options;
+    Messenger& bus;
+    QTimer* timer = nullptr;
+    QLocalServer* server = nullptr;
+    QByteArray latest;
+};
+
+MessengerMetricsExporter::MessengerMetricsExporter(const MetricsExportOptions& options, Messenger& bus)
+    : bus(bus)
+    , previousLatencyTracking(bus.LatencyTracking()) {
+    bus.SetLatencyTracking(true);
+    thread.setObjectName("MessengerMetrics");
+    worker = new Worker(options, bus);
+    worker->moveToThread(&thread);
+    QObject::connect(&thread, &QThread::finished, worker, &QObject::deleteLater);
+    thread.start();
+    QMetaObject::invokeMethod(worker, [w = worker] { w->start(); }, Qt::QueuedConnection);
+}
+
+MessengerMetricsExporter::~MessengerMetricsExporter() {
+    thread.quit();
+    thread.wait();
+    bus.SetLatencyTracking(previousLatencyTracking);
+}
@@ -0,0 +1,49 @@
+// MessengerMetrics.h
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QThread>
+#include "Messenger.h"
+
+// ──────────────────────────────────────────────────────────────
+// Prometheus 文本格式指标导出
+//
+// 在独立后台线程中定期从 Messenger::Stats() 取快照并格式化，发送路径上
+// 只有原子计数（导出器存续期间打开 SetLatencyTracking，析构时恢复原设置）。输出方式二选一或同时使用：
+// - filePath：原子替换写入文本文件，供本地采集 agent 读取（textfile collector）
+// - serverName：QLocalServer，每个连接写入最新一份指标后断开
+//
+// 指标：
+//   messenger_messages_matched_total{type,token}     counter
+//   messenger_messages_delivered_total{type,token}   counter
+//   messenger_delivery_latency_seconds{type,token}   histogram（Send → 回调开始）
+//   messenger_subscriptions{type}                    gauge
+//   messenger_mailbox_depth{thread}                  gauge（已排队未执行的投递）
+//   messenger_message_type_info{type,size,...}       gauge（恒为 1，类型注册表信息）
+//   messenger_dispatch_wakeups_total{thread}         counter（线程分发器排空次数）
+//   messenger_dispatch_batch_size{thread}            histogram（每次排空执行的投递数）
+//   messenger_pool_active_threads / messenger_pool_max_threads  gauge
+// ──────────────────────────────────────────────────────────────
+struct MetricsExportOptions {
+    QString filePath;        // 为空则不写文件
+    QString serverName;      // 为空则不启动 QLocalServer
+    int intervalMs = 5000;   // 刷新周期
+};
+
+class MESSAGING_API MessengerMetricsExporter {
+public:
+    explicit MessengerMetricsExporter(const MetricsExportOptions& options, Messenger& bus = Messenger::Default());
+    ~MessengerMetricsExporter();
+
+    // 立即生成一份 Prometheus 文本（可在任意线程调用）
+    static QByteArray PrometheusText(const Messenger& bus = Messenger::Default());
+
+private:
+    class Worker;
+    QThread thread;
+    Worker* worker = nullptr;
+    Messenger& bus;
+    bool previousLatencyTracking = false;  // 构造前的延迟统计设置，析构时恢复
+
+    Q_DISABLE_COPY_MOVE(MessengerMetricsExporter)
+};
@@ -0,0 +1,296 @@
+#include "MessengerShards.h"
+#include "SpscQueue.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <atomic>
+
+struct MessengerShards::Shard {
+    QThread* thread = nullptr;
+    QObject* dispatcher = nullptr;          // 位于 thread 中，作为唤醒与转交的上下文
+    QList<Subscription> subscriptions;      // 仅 thread 访问
+
+    // interest 的只读副本：仅 thread 访问，版本号变化时整体刷新，发送路径不写共享内存
+    QHash<quint64, quint64> interestCache;
+    quint64 interestVersion = 0;
+
+    // lanes[i]：来自分片 i 的 SPSC 邮箱，由分片 i 首次发送时创建
+    std::unique_ptr<std::atomic<SpscQueue<Envelope>*>[]> lanes;
+    QMutex externalMutex;
+    QList<Envelope> external;               // 非分片线程发来的消息
+    std::atomic<bool> wakeupPending{false};
+};
+
+namespace {
+std::atomic<quint64> nextInstanceId{1};
+
+// 当前线程在最近一次查询的实例中的分片下标；线程不会更换所属分片，缓存无需失效
+struct ShardCache {
+    quint64 instance = 0;
+    int index = -1;
+};
+thread_local ShardCache shardCache;
+}
+
+// type -> 订阅该类型的分片位图。分片线程发送时读取自己的副本，
+// 只在 version 变化（某分片首次订阅 / 最后注销某类型）时加锁复制
+struct MessengerShards::Interest {
+    QMutex mutex;
+    QHash<quint64, quint64> map;      // 受 mutex 保护
+    std::atomic<quint64> version{0};  // 每次修改 map 后递增
+};
+
+MessengerShards::MessengerShards(int count)
+    : instanceId(nextInstanceId.fetch_add(1, std::memory_order_relaxed)) {
+    if (count < 1) count = 1;
+    if (count > 64) count = 64;
+    QList<QThread*> threads;
+    for (int i = 0; i < count; ++i) {
+        auto* thread = new QThread();
+        thread->setObjectName(QString("MessengerShard-%1").arg(i));
+        thread->start();
+        threads.append(thread);
+    }
+    ownedThreads = threads;
+    init(threads);
+}
+
+MessengerShards::MessengerShards(const QList<QThread*>& threads)
+    : instanceId(nextInstanceId.fetch_add(1, std::memory_order_relaxed)) {
+    init(threads.size() > 64 ? threads.mid(0, 64) : threads);
+}
+
+MessengerShards::~MessengerShards() {
+    for (QThread* thread : std::as_const(ownedThreads)) {
+        thread->quit();
+        thread->wait();
+    }
+    for (auto& shard : shards) {
+        delete shard->dispatcher;
+        for (int i = 0; i < static_cast<int>(shards.size()); ++i) {
+            delete shard->lanes[i].load(std::memory_order_acquire);
+        }
+    }
+    qDeleteAll(ownedThreads);
+}
+
+void MessengerShards::init(const QList<QThread*>& threads) {
+    interest = std::make_unique<Interest>();
+    const int count = threads.size();
+    shards.reserve(count);
+    for (QThread* thread : threads) {
+        auto shard = std::make_unique<Shard>();
+        shard->thread = thread;
+        shard->dispatcher = new QObject();
+        shard->dispatcher->moveToThread(thread);
+        shard->lanes.reset(new std::atomic<SpscQueue<Envelope>*>[count]);
+        for (int i = 0; i < count; ++i) {
+            shard->lanes[i].store(nullptr, std::memory_order_relaxed);
+        }
+        shards.push_back(std::move(shard));
+    }
+}
+
+int MessengerShards::shardCount() const {
+    return static_cast<int>(shards.size());
+}
+
+QThread* MessengerShards::shardThread(int index) const {
+    if (index < 0 || index >= shardCount()) return nullptr;
+    return shards[index]->thread;
+}
+
+int MessengerShards::shardOf(QThread* thread) const {
+    for (int i = 0; i < shardCount(); ++i) {
+        if (shards[i]->thread == thread) return i;
+    }
+    return -1;
+}
+
+int MessengerShards::currentShard() const {
+    if (shardCache.instance != instanceId) {
+        shardCache.index = shardOf(QThread::currentThread());
+        shardCache.instance = instanceId;
+    }
+    return shardCache.index;
+}
+
+quint64 MessengerShards::interestOf(quint64 type, int self) const {
+    if (self < 0) {
+        // 非分片线程：直接读共享表（这类发送本就经由加锁的外部邮箱）
+        QMutexLocker locker(&interest->mutex);
+        return interest->map.value(type, 0);
+    }
+    Shard& shard = *shards[self];
+    if (shard.interestVersion != interest->version.load(std::memory_order_acquire)) {
+        QMutexLocker locker(&interest->mutex);
+        shard.interestCache = interest->map;
+        shard.interestVersion = interest->version.load(std::memory_order_relaxed);
+    }
+    return shard.interestCache.value(type, 0);
+}
+
+void MessengerShards::markInterest(quint64 type, int shard) {
+    QMutexLocker locker(&interest->mutex);
+    const quint64 bit = quint64(1) << shard;
+    const quint64 mask = interest->map.value(type, 0);
+    if (mask & bit) return;
+    interest->map.insert(type, mask | bit);
+    interest->version.fetch_add(1, std::memory_order_release);
+}
+
+void MessengerShards::dropInterestIfUnused(quint64 type, int shard) {
+    for (const auto& sub : std::as_const(shards[shard]->subscriptions)) {
+        if (sub.type == type) return;
+    }
+    QMutexLocker locker(&interest->mutex);
+    const quint64 bit = quint64(1) << shard;
+    const quint64 mask = interest->map.value(type, 0);
+    if (!(mask & bit)) return;
+    if (mask == bit) {
+        interest->map.remove(type);
+    } else {
+        interest->map.insert(type, mask & ~bit);
+    }
+    interest->version.fetch_add(1, std::memory_order_release);
+}
+
+void MessengerShards::internalRegister(quint64 type, const MessageToken& token, QObject* receiver, std::function<void(const QVariant&)>&& cb) {
+    if (!receiver) return;
+    const int index = shardOf(receiver->thread());
+    if (index < 0) {
+        qWarning() << "MessengerShards: receiver" << receiver << "does not live in a shard thread";
+        return;
+    }
+    // 先置位 interest，保证注册转交期间发出的消息也会送达该分片
+    markInterest(type, index);
+    Subscription sub{type, token, QPointer<QObject>(receiver), std::move(cb)};
+    Shard& shard = *shards[index];
+    if (QThread::currentThread() == shard.thread) {
+        shard.subscriptions.append(std::move(sub));
+        return;
+    }
+    QMetaObject::invokeMethod(shard.dispatcher, [this, index, sub] {
+        markInterest(sub.type, index);
+        shards[index]->subscriptions.append(sub);
+    }, Qt::QueuedConnection);
+}
+
+void MessengerShards::Unregister(QObject* receiver) {
+    if (!receiver) return;
+    internalUnregister(receiver, false, 0, MessageToken());
+}
+
+void MessengerShards::Cleanup() {
+    // 已析构接收者的 QPointer 为空，按空接收者注销即移除它们的订阅
+    internalUnregister(nullptr, false, 0, MessageToken());
+}
+
+void MessengerShards::internalUnregister(QObject* receiver, bool byType, quint64 type, const MessageToken& token) {
+    for (int i = 0; i < shardCount(); ++i) {
+        Shard& shard = *shards[i];
+        if (QThread::currentThread() == shard.thread) {
+            removeLocal(i, receiver, byType, type, token);
+        } else {
+            QMetaObject::invokeMethod(shard.dispatcher, [this, i, receiver, byType, type, token] {
+                removeLocal(i, receiver, byType, type, token);
+            }, Qt::QueuedConnection);
+        }
+    }
+}
+
+void MessengerShards::removeLocal(int index, QObject* receiver, bool byType, quint64 type, const MessageToken& token) {
+    auto& subscriptions = shards[index]->subscriptions;
+    QSet<quint64> touched;
+    for (auto it = subscriptions.begin(); it != subscriptions.end(); ) {
+        if (it->receiver.data() == receiver &&
+            (!byType || (it->type == type && (token.isEmpty() || it->token == token)))) {
+            touched.insert(it->type);
+            it = subscriptions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (quint64 t : std::as_const(touched)) {
+        dropInterestIfUnused(t, index);
+    }
+}
+
+void MessengerShards::internalSend(quint64 type, const MessageToken& token, const QVariant& payload) {
+    const int self = currentShard();
+    const quint64 mask = interestOf(type, self);
+    if (!mask) return;
+    for (int i = 0; i < shardCount(); ++i) {
+        if (!(mask & (quint64(1) << i))) continue;
+        if (i == self) {
+            deliverLocal(i, type, token, payload);
+        } else {
+            post(self, i, Envelope{type, token, payload});
+        }
+    }
+}
+
+void MessengerShards::post(int from, int to, Envelope&& envelope) {
+    Shard& target = *shards[to];
+    if (from >= 0) {
+        SpscQueue<Envelope>* lane = target.lanes[from].load(std::memory_order_acquire);
+        if (!lane) {
+            // 只有分片 from 会创建 lanes[from]，无需 CAS
+            lane = new SpscQueue<Envelope>();
+            target.lanes[from].store(lane, std::memory_order_release);
+        }
+        lane->push(std::move(envelope));
+    } else {
+        QMutexLocker locker(&target.externalMutex);
+        target.external.append(std::move(envelope));
+    }
+    if (!target.wakeupPending.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(target.dispatcher, [this, to] { drain(to); }, Qt::QueuedConnection);
+    }
+}
+
+void MessengerShards::drain(int index) {
+    Shard& shard = *shards[index];
+    // 先清除唤醒标记再排空：之后到达的消息会触发新的唤醒
+    shard.wakeupPending.exchange(false, std::memory_order_acq_rel);
+
+    Envelope envelope;
+    for (int i = 0; i < shardCount(); ++i) {
+        SpscQueue<Envelope>* lane = shard.lanes[i].load(std::memory_order_acquire);
+        if (!lane) continue;
+        while (lane->pop(envelope)) {
+            deliverLocal(index, envelope.type, envelope.token, envelope.payload);
+        }
+    }
+
+    QList<Envelope> external;
+    {
+        QMutexLocker locker(&shard.externalMutex);
+        external.swap(shard.external);
+    }
+    for (const auto& e : std::as_const(external)) {
+        deliverLocal(index, e.type, e.token, e.payload);
+    }
+}
+
+void MessengerShards::deliverLocal(int index, quint64 type, const MessageToken& token, const QVariant& payload) {
+    auto& subscriptions = shards[index]->subscriptions;
+    bool removed = false;
+    // 按下标遍历：回调内可能注册/注销本分片的订阅
+    for (int i = 0; i < subscriptions.size(); ++i) {
+        const Subscription& candidate = subscriptions.at(i);
+        if (candidate.type != type) continue;
+        if (candidate.receiver.isNull()) {
+            // 接收者已析构：顺带移除订阅
+            subscriptions.removeAt(i--);
+            removed = true;
+            continue;
+        }
+        const bool tokenMatch = candidate.token.isEmpty() || token.isEmpty() || candidate.token == token;
+        if (!tokenMatch) continue;
+        // 只复制匹配的订阅：回调可能修改 subscriptions，引用随之失效
+        const Subscription sub = candidate;
+        sub.callback(payload);
+    }
+    if (removed) dropInterestIfUnused(type, index);
+}
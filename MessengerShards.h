@@ -0,0 +1,141 @@
+// MessengerShards.h
+#pragma once
+#include <QObject>
+#include <QList>
+#include <QPointer>
+#include <QThread>
+#include <QVariant>
+#include <memory>
+#include <vector>
+#include "Messenger.h"
+
+// ──────────────────────────────────────────────────────────────
+// 分片总线（shared-nothing）
+//
+// 每个分片绑定一个线程并独占自己的订阅表：注册/注销/匹配都只在该线程进行。
+// 发送方所在分片的订阅者直接调用；其他分片的消息写入“发送分片→接收分片”
+// 专属的 SPSC 邮箱，并在目标分片没有待处理唤醒时投递一次唤醒。
+// 非分片线程发送时使用目标分片的加锁外部邮箱。
+//
+// 发送方只会向订阅了该类型的分片投递（interest 位图，仅在某分片首次订阅 /
+// 最后注销该类型时更新）。每个分片持有位图的只读副本，按版本号刷新，
+// 本地流量为主的负载下发送路径不写任何共享内存，分片之间不共享任何缓存行。
+//
+// 约束：
+// - 接收者必须位于某个分片线程中；从其他线程注册/注销会异步转交给所属分片。
+// - 最多 64 个分片。
+// - 使用外部线程构造时，需在这些线程结束后再析构 MessengerShards。
+// ──────────────────────────────────────────────────────────────
+class MESSAGING_API MessengerShards {
+public:
+    // 创建 count 个自有线程，每个线程一个分片
+    explicit MessengerShards(int count = QThread::idealThreadCount());
+    // 以已有线程作为分片（可包含主线程）
+    explicit MessengerShards(const QList<QThread*>& threads);
+    ~MessengerShards();
+
+    int shardCount() const;
+    QThread* shardThread(int index) const;
+    int shardOf(QThread* thread) const;   // 不属于任何分片时返回 -1
+
+    // ----------------------------------------------------------
+    // Register: 成员函数
+    // ----------------------------------------------------------
+    template<typename TMsg, typename TReceiver>
+    void Register(TReceiver* receiver, void (TReceiver::*method)(const TMsg&), const MessageToken& token = MessageToken()) {
+        Register<TMsg>(receiver, [receiver, method](const TMsg& msg) {
+            (receiver->*method)(msg);
+        }, token);
+    }
+
+    // ----------------------------------------------------------
+    // Register: lambda / std::function
+    // ----------------------------------------------------------
+    template<typename TMsg, typename TFunc>
+    void Register(QObject* receiver, TFunc&& callback, const MessageToken& token = MessageToken()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            auto wrapper = [callback = std::forward<TFunc>(callback)](const QVariant& var) {
+                callback(MessengerDetail::messageRef<TMsg>(var));
+            };
+            internalRegister(typeid(TMsg).hash_code(), token, receiver, std::move(wrapper));
+        }
+    }
+
+    // ----------------------------------------------------------
+    // Send
+    // ----------------------------------------------------------
+    template<typename TMsg>
+    void Send(const TMsg& message, const MessageToken& token = MessageToken()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            QVariant payload;
+            payload.setValue(message);
+            internalSend(typeid(TMsg).hash_code(), token, payload);
+        } else {
+            Q_UNUSED(message)
+            Q_UNUSED(token)
+        }
+    }
+
+    template<typename TMsg, typename TFactory>
+    void SendWith(TFactory&& factory, const MessageToken& token = MessageToken()) {
+        if constexpr (MessageTypeEnabled<TMsg>::value) {
+            Send<TMsg>(std::forward<TFactory>(factory)(), token);
+        } else {
+            Q_UNUSED(factory)
+            Q_UNUSED(token)
+        }
+    }
+
+    // ----------------------------------------------------------
+    // Unregister（全部 / 按类型 / 按 Token）
+    // ----------------------------------------------------------
+    void Unregister(QObject* receiver);
+
+    template<typename TMsg>
+    void Unregister(QObject* receiver, const MessageToken& token = MessageToken()) {
+        internalUnregister(receiver, true, typeid(TMsg).hash_code(), token);
+    }
+
+    // ----------------------------------------------------------
+    // Cleanup：移除已析构接收者的订阅（投递时遇到的会顺带移除）
+    // ----------------------------------------------------------
+    void Cleanup();
+
+private:
+    struct Subscription {
+        quint64 type;
+        MessageToken token;
+        QPointer<QObject> receiver;
+        std::function<void(const QVariant&)> callback;
+    };
+
+    struct Envelope {
+        quint64 type = 0;
+        MessageToken token;
+        QVariant payload;
+    };
+
+    struct Shard;
+    struct Interest;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::unique_ptr<Interest> interest;
+    QList<QThread*> ownedThreads;
+    const quint64 instanceId;   // 区分实例（地址可能被复用），用于线程局部的分片缓存
+
+    Q_DISABLE_COPY_MOVE(MessengerShards)
+
+    void init(const QList<QThread*>& threads);
+    int currentShard() const;
+    quint64 interestOf(quint64 type, int self) const;
+    void markInterest(quint64 type, int shard);
+    void dropInterestIfUnused(quint64 type, int shard);
+
+    void internalRegister(quint64 type, const MessageToken& token, QObject* receiver, std::function<void(const QVariant&)>&& cb);
+    void internalUnregister(QObject* receiver, bool byType, quint64 type, const MessageToken& token);
+    void internalSend(quint64 type, const MessageToken& token, const QVariant& payload);
+
+    void post(int from, int to, Envelope&& envelope);
+    void drain(int index);
+    void deliverLocal(int index, quint64 type, const MessageToken& token, const QVariant& payload);
+    void removeLocal(int index, QObject* receiver, bool byType, quint64 type, const MessageToken& token);
+};
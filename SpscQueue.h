@@ -0,0 +1,72 @@
+// SpscQueue.h
+#pragma once
+#include <atomic>
+#include <utility>
+
+// ──────────────────────────────────────────────────────────────
+// 单生产者 / 单消费者无锁队列（无界，按块链接）
+//
+// 生产者只写 tail 块，消费者只读 head 块；块写满后由生产者追加新块，
+// 消费者读完一个块后释放它。除块分配外 push/pop 不加锁、不分配。
+// T 需可默认构造与移动赋值。
+// ──────────────────────────────────────────────────────────────
+template<typename T, int BlockSize = 64>
+class SpscQueue {
+public:
+    SpscQueue() : head(new Block), tail(head) {}
+
+    ~SpscQueue() {
+        while (head) {
+            Block* next = head->next.load(std::memory_order_relaxed);
+            delete head;
+            head = next;
+        }
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // 仅生产者线程调用
+    void push(T&& value) {
+        int w = tail->written.load(std::memory_order_relaxed);
+        if (w == BlockSize) {
+            Block* block = new Block;
+            tail->next.store(block, std::memory_order_release);
+            tail = block;
+            w = 0;
+        }
+        tail->cells[w] = std::move(value);
+        tail->written.store(w + 1, std::memory_order_release);
+    }
+
+    // 仅消费者线程调用；队列为空时返回 false
+    bool pop(T& out) {
+        for (;;) {
+            if (readIndex < head->written.load(std::memory_order_acquire)) {
+                out = std::move(head->cells[readIndex]);
+                head->cells[readIndex] = T();
+                ++readIndex;
+                return true;
+            }
+            if (readIndex < BlockSize) return false;
+            Block* next = head->next.load(std::memory_order_acquire);
+            if (!next) return false;
+            delete head;
+            head = next;
+            readIndex = 0;
+        }
+    }
+
+private:
+    struct Block {
+        T cells[BlockSize];
+        std::atomic<int> written{0};
+        std::atomic<Block*> next{nullptr};
+    };
+
+    // 消费者独占
+    alignas(64) Block* head;
+    int readIndex = 0;
+    // 生产者独占
+    alignas(64) Block* tail;
+};
@@ -7,6 +7,15 @@ SOURCES += \
 
 HEADERS += \
     ../Messenger.h \
+    ../MessageActor.h \
+    ../MessageDispatcher.h \
+    ../MessageExecutor.h \
+    ../MessageJoin.h \
+    ../MessageStrand.h \
+    ../MessageTracer.h \
+    ../MessengerHooks.h \
+    ../MessengerMetrics.h \
+    ../MessengerShards.h \
     tst_Messenger.h
 
 INCLUDEPATH += ..
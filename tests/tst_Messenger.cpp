@@ -3,6 +3,12 @@
 #include <QThread>
 #include <QSignalSpy>
 #include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSemaphore>
+#include <QTemporaryDir>
+#include <algorithm>
 #include <thread>
 #include <vector>
 #include "tst_Messenger.h"
@@ -17,6 +23,21 @@ void TestReceiver::onMessage(const MyMessage& msg)
     emit messageReceived();
 }
 
+void TestReceiver::onMessageWithEnvelope(const MyMessage& msg, const MessageEnvelope& envelope)
+{
+    received.append(msg);
+    envelopes.append(envelope);
+    emit messageReceived();
+}
+
+void CountingActor::onMessage(const MyMessage& msg)
+{
+    if (inHandler.fetch_add(1) != 0) overlapped = true;
+    codes.append(msg.code);
+    inHandler.fetch_sub(1);
+    ++count;
+}
+
 void MessengerTest::waitForDispatch(int ms)
 {
     // 为异步分发保留时间窗口；在跨线程用例中配合 QTRY_COMPARE 使用
@@ -27,6 +48,7 @@ void MessengerTest::init() {
     // 每个用例开始前：清空接收者状态并移除上次遗留的订阅
     memberReceiver.received.clear();
     lambdaReceived.clear();
+    memberReceiver.envelopes.clear();
     Messenger::Default().Cleanup();
     Messenger::Default().Unregister(&memberReceiver);
     Messenger::Default().Unregister(&lambdaReceiver);
@@ -388,4 +410,1359 @@ void MessengerTest::broadcast_many_receivers() {
     }
 }
 
+void MessengerTest::join_pairs_by_key() {
+    // 按键关联：code 与 value 相同的两条消息组合为一次回调，先后顺序无关
+    QList<JoinedMessage<MyMessage, AnotherMessage>> joined;
+    MessageJoin<MyMessage, AnotherMessage, int> join(
+        [](const MyMessage& m) { return m.code; },
+        [](const AnotherMessage& m) { return m.value; },
+        [&joined](const JoinedMessage<MyMessage, AnotherMessage>& j) { joined.append(j); });
+
+    Messenger::Default().Send<MyMessage>({1, "left-first"});
+    Messenger::Default().Send<AnotherMessage>({2, "right-first"});
+    Messenger::Default().Send<AnotherMessage>({1, "match-1"});
+    Messenger::Default().Send<MyMessage>({2, "match-2"});
+    waitForDispatch();
+
+    QCOMPARE(joined.size(), 2);
+    QCOMPARE(joined[0].left, (MyMessage{1, "left-first"}));
+    QCOMPARE(joined[0].right, (AnotherMessage{1, "match-1"}));
+    QCOMPARE(joined[1].left, (MyMessage{2, "match-2"}));
+    QCOMPARE(joined[1].right, (AnotherMessage{2, "right-first"}));
+    QCOMPARE(join.pendingLeft(), 0);
+    QCOMPARE(join.pendingRight(), 0);
+}
+
+void MessengerTest::join_bounded_by_capacity_and_ttl() {
+    // 容量与 TTL：超出容量淘汰最旧条目，过期条目不再参与匹配
+    int joinedCount = 0;
+    JoinOptions options;
+    options.capacity = 4;
+    options.ttlMs = 50;
+    MessageJoin<MyMessage, AnotherMessage, int> join(
+        [](const MyMessage& m) { return m.code; },
+        [](const AnotherMessage& m) { return m.value; },
+        [&joinedCount](const JoinedMessage<MyMessage, AnotherMessage>&) { ++joinedCount; },
+        options);
+
+    for (int i = 0; i < 10; ++i) {
+        Messenger::Default().Send<MyMessage>({i, "unmatched"});
+    }
+    waitForDispatch();
+    QCOMPARE(join.pendingLeft(), 4);
+    QCOMPARE(join.evictedCount(), quint64(6));
+
+    // 最旧的键已被淘汰，无法再匹配
+    Messenger::Default().Send<AnotherMessage>({0, "late"});
+    waitForDispatch();
+    QCOMPARE(joinedCount, 0);
+
+    waitForDispatch(options.ttlMs * 2);
+    join.EvictExpired();
+    QCOMPARE(join.pendingLeft(), 0);
+    QCOMPARE(join.pendingRight(), 0);
+}
+
+void MessengerTest::shards_local_and_cross_shard_delivery() {
+    // 分片总线：主线程与 worker 各为一个分片；本分片订阅者直接调用，
+    // 其他分片与非分片线程的消息经邮箱在目标线程投递
+    QThread worker;
+    worker.start();
+    MessengerShards shards(QList<QThread*>{QThread::currentThread(), &worker});
+    QCOMPARE(shards.shardCount(), 2);
+    QCOMPARE(shards.shardOf(&worker), 1);
+
+    auto* remote = new TestReceiver();
+    remote->moveToThread(&worker);
+    QSignalSpy spy(remote, &TestReceiver::messageReceived);
+    shards.Register<MyMessage>(&memberReceiver, &TestReceiver::onMessage);
+    shards.Register<MyMessage>(remote, &TestReceiver::onMessage);
+
+    shards.Send<MyMessage>({1, "from-shard-0"});
+    QCOMPARE(memberReceiver.received.size(), 1);
+
+    std::thread external([&shards]() { shards.Send<MyMessage>({2, "external"}); });
+    external.join();
+
+    QTRY_COMPARE(spy.count(), 2);
+    QTRY_COMPARE(memberReceiver.received.size(), 2);
+    QCOMPARE(memberReceiver.received[1], (MyMessage{2, "external"}));
+
+    // 分片总线与默认总线互相独立
+    Messenger::Default().Send<MyMessage>({3, "default"});
+    waitForDispatch();
+    QCOMPARE(memberReceiver.received.size(), 2);
+
+    shards.Unregister(&memberReceiver);
+    shards.Send<MyMessage>({4, "after-unregister"});
+    QCOMPARE(memberReceiver.received.size(), 2);
+
+    // 接收者未注销就析构：投递时顺带移除其订阅，Cleanup 清理其余分片的残留
+    auto* doomed = new TestReceiver();
+    shards.Register<MyMessage>(doomed, &TestReceiver::onMessage);
+    delete doomed;
+    shards.Send<MyMessage>({5, "after-delete"});
+    shards.Cleanup();
+    QCOMPARE(memberReceiver.received.size(), 2);
+
+    worker.quit();
+    worker.wait();
+    delete remote;
+}
+
+void MessengerTest::actor_receives_in_order() {
+    // Actor 订阅：成员函数与 lambda 使用同一 Register 接口，消息在线程池中按序执行
+    QVERIFY(sizeof(MessageActor) <= 64);
+    CountingActor actor;
+    std::atomic<int> lambdaCount{0};
+    Messenger::Default().Register<MyMessage>(&actor, &CountingActor::onMessage);
+    Messenger::Default().Register<AnotherMessage>(&actor, [&lambdaCount](const AnotherMessage&) { ++lambdaCount; });
+
+    const int N = 200;
+    for (int i = 0; i < N; ++i) {
+        Messenger::Default().Send<MyMessage>({i, "actor"});
+    }
+    Messenger::Default().Send<AnotherMessage>({1, "actor"});
+    QTRY_COMPARE(actor.count.load(), N);
+    QTRY_COMPARE(lambdaCount.load(), 1);
+    QTRY_VERIFY(actor.isIdle());
+    for (int i = 0; i < N; ++i) {
+        QCOMPARE(actor.codes[i], i);
+    }
+
+    Messenger::Default().Unregister(&actor);
+    Messenger::Default().Send<MyMessage>({N, "after-unregister"});
+    waitForDispatch();
+    QCOMPARE(actor.count.load(), N);
+}
+
+void MessengerTest::actor_close_waits_and_drops() {
+    // close()：先注销再关闭邮箱；执行中的回调结束前不会返回，排队中的任务被丢弃，
+    // 之后即使有持有旧订阅快照的发送方投递，也只会被已关闭的邮箱丢弃
+    CountingActor actor;
+    QSemaphore entered;
+    QSemaphore release;
+    std::atomic<int> finished{0};
+    Messenger::Default().Register<MyMessage>(&actor, [&](const MyMessage& msg) {
+        if (msg.code == 0) {
+            entered.release();
+            release.acquire();
+        }
+        ++finished;
+    });
+    Messenger::Default().Send<MyMessage>({0, "running"});
+    Messenger::Default().Send<MyMessage>({1, "queued"});
+    entered.acquire();
+
+    std::atomic<bool> closed{false};
+    std::thread closer([&actor, &closed] {
+        actor.close();
+        closed = true;
+    });
+    QTRY_VERIFY(actor.isClosed());
+    QVERIFY(!closed.load());
+    release.release();
+    closer.join();
+    QCOMPARE(finished.load(), 1);
+    QVERIFY(actor.isIdle());
+
+    actor.post([&finished] { ++finished; });
+    Messenger::Default().Send<MyMessage>({2, "after-close"});
+    waitForDispatch();
+    QCOMPARE(finished.load(), 1);
+}
+
+void MessengerTest::actor_handlers_never_overlap() {
+    // 串行语义：多线程并发发送，Actor 回调不会同时执行
+    CountingActor actor;
+    Messenger::Default().Register<MyMessage>(&actor, &CountingActor::onMessage);
+
+    const int threads = 4;
+    const int perThread = 250;
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back([perThread]() {
+            for (int i = 0; i < perThread; ++i) {
+                Messenger::Default().Send<MyMessage>({i, "concurrent"});
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+
+    QTRY_COMPARE(actor.count.load(), threads * perThread);
+    QVERIFY(!actor.overlapped.load());
+    Messenger::Default().Unregister(&actor);
+}
+
+void MessengerTest::weak_ptr_receiver_lifetime() {
+    // weak_ptr 接收者：无需 QObject；释放后跳过投递，Cleanup 移除过期条目
+    auto service = std::make_shared<SharedService>();
+    QList<MyMessage> lambdaSeen;
+    Messenger::Default().Register<MyMessage>(service, &SharedService::onMessage);
+    Messenger::Default().Register<MyMessage>(std::weak_ptr<SharedService>(service),
+        [&lambdaSeen](const MyMessage& m) { lambdaSeen.append(m); });
+
+    Messenger::Default().Send<MyMessage>({1, "alive"});
+    QCOMPARE(service->received.size(), 1);
+    QCOMPARE(lambdaSeen.size(), 1);
+
+    std::weak_ptr<SharedService> watcher = service;
+    service.reset();
+    QVERIFY(watcher.expired());
+    Messenger::Default().Send<MyMessage>({2, "expired"});
+    QCOMPARE(lambdaSeen.size(), 1);
+
+    Messenger::Default().Cleanup();
+    Messenger::Default().Send<MyMessage>({3, "after-cleanup"});
+    QCOMPARE(lambdaSeen.size(), 1);
+}
+
+void MessengerTest::weak_ptr_receiver_unregister() {
+    // shared_ptr 接收者注销：按类型 + Token 精确移除，再按对象全部移除
+    auto service = std::make_shared<SharedService>();
+    const MessageToken tokenA{"A"};
+    const MessageToken tokenB{"B"};
+    Messenger::Default().Register<MyMessage>(service, &SharedService::onMessage, tokenA);
+    Messenger::Default().Register<MyMessage>(service, &SharedService::onMessage, tokenB);
+
+    Messenger::Default().Unregister<MyMessage>(service, tokenA);
+    Messenger::Default().Send<MyMessage>({1, "a"}, tokenA);
+    Messenger::Default().Send<MyMessage>({2, "b"}, tokenB);
+    QCOMPARE(service->received.size(), 1);
+    QCOMPARE(service->received.front(), (MyMessage{2, "b"}));
+
+    Messenger::Default().Unregister(service);
+    Messenger::Default().Send<MyMessage>({3, "none"});
+    QCOMPARE(service->received.size(), 1);
+}
+
+void MessengerTest::executor_routes_to_pool_and_thread() {
+    // 执行器决定回调运行位置：线程池执行器不在主线程，线程执行器经 worker 线程的分发器在该线程执行
+    QThread worker;
+    worker.start();
+    const auto dispatcher = MessageDispatcher::ForThread(&worker);
+    const quint64 deliveriesBefore = dispatcher->stats().deliveries;
+    std::atomic<QThread*> poolThread{nullptr};
+    std::atomic<QThread*> workerThread{nullptr};
+    Messenger::Default().Register<MyMessage>(&lambdaReceiver,
+        [&poolThread](const MyMessage&) { poolThread = QThread::currentThread(); },
+        MessageExecutor::Pool());
+    Messenger::Default().Register<MyMessage>(&lambdaReceiver,
+        [&workerThread](const MyMessage&) { workerThread = QThread::currentThread(); },
+        MessageExecutor::Thread(&worker));
+
+    Messenger::Default().Send<MyMessage>({1, "exec"});
+    QTRY_VERIFY(poolThread.load() != nullptr);
+    QTRY_VERIFY(workerThread.load() != nullptr);
+    QVERIFY(poolThread.load() != QThread::currentThread());
+    QCOMPARE(workerThread.load(), &worker);
+    QTRY_COMPARE(dispatcher->stats().deliveries - deliveriesBefore, quint64(1));
+
+    Messenger::Default().Unregister(&lambdaReceiver);
+    Messenger::WorkerPool()->waitForDone();
+    worker.quit();
+    worker.wait();
+}
+
+void MessengerTest::executor_custom_and_receiverless() {
+    // 自定义执行器：包装任意调度函数；无接收者订阅由执行器持有，按执行器注销
+    int executed = 0;
+    auto executor = MessageExecutor::Wrap([&executed](std::function<void()> task) {
+        ++executed;
+        task();
+    });
+    auto service = std::make_shared<SharedService>();
+    QList<MyMessage> seen;
+    Messenger::Default().Register<MyMessage>(executor, [&seen](const MyMessage& m) { seen.append(m); });
+    Messenger::Default().Register<MyMessage>(service, &SharedService::onMessage, executor);
+
+    Messenger::Default().Send<MyMessage>({5, "custom"});
+    QCOMPARE(executed, 2);
+    QCOMPARE(seen.size(), 1);
+    QCOMPARE(service->received.size(), 1);
+
+    Messenger::Default().Unregister(executor);
+    Messenger::Default().Send<MyMessage>({6, "after"});
+    QCOMPARE(seen.size(), 1);
+    QCOMPARE(service->received.size(), 2);
+    Messenger::Default().Unregister(service);
+}
+
+void MessengerTest::strand_serializes_handlers() {
+    // Strand：两种消息的回调共享一个 Strand，在线程池上运行但互不并发，单一发送方的顺序保持
+    auto strand = MessageStrand::Create();
+    std::atomic<int> inHandler{0};
+    std::atomic<bool> overlapped{false};
+    std::atomic<bool> onStrand{true};
+    QList<int> codes;                // 仅在 Strand 上写入；主线程在计数到齐后读取
+    std::atomic<int> codeCount{0};
+    std::atomic<int> anotherCount{0};
+    auto enter = [&]() {
+        if (inHandler.fetch_add(1) != 0) overlapped = true;
+        if (!strand->runningInThisThread()) onStrand = false;
+    };
+    Messenger::Default().Register<MyMessage>(&lambdaReceiver, [&](const MyMessage& m) {
+        enter();
+        codes.append(m.code);
+        codeCount.fetch_add(1, std::memory_order_release);
+        inHandler.fetch_sub(1);
+    }, strand);
+    Messenger::Default().Register<AnotherMessage>(&lambdaReceiver, [&](const AnotherMessage&) {
+        enter();
+        ++anotherCount;
+        inHandler.fetch_sub(1);
+    }, strand);
+
+    const int N = 300;
+    std::thread other([N]() {
+        for (int i = 0; i < N; ++i) Messenger::Default().Send<AnotherMessage>({i, "strand"});
+    });
+    for (int i = 0; i < N; ++i) {
+        Messenger::Default().Send<MyMessage>({i, "strand"});
+    }
+    other.join();
+
+    QTRY_VERIFY(strand->pending() == 0 && codeCount.load(std::memory_order_acquire) == N && anotherCount.load() == N);
+    QCOMPARE(codes.size(), N);
+    QVERIFY(!overlapped.load());
+    QVERIFY(onStrand.load());
+    QVERIFY(!strand->runningInThisThread());
+    for (int i = 0; i < N; ++i) {
+        QCOMPARE(codes[i], i);
+    }
+    Messenger::Default().Unregister(&lambdaReceiver);
+    Messenger::WorkerPool()->waitForDone();
+}
+
+void MessengerTest::dedup_drops_repeated_ids() {
+    // 去重：按 code 去重，重复消息在发送端丢弃，不影响其他类型
+    Messenger::Default().EnableDeduplication<MyMessage>([](const MyMessage& m) { return m.code; });
+    Messenger::Default().Register<MyMessage>(&memberReceiver, &TestReceiver::onMessage);
+
+    Messenger::Default().Send<MyMessage>({1, "first"});
+    Messenger::Default().Send<MyMessage>({1, "retry"});
+    Messenger::Default().Send<MyMessage>({2, "second"});
+    waitForDispatch();
+
+    QCOMPARE(memberReceiver.received.size(), 2);
+    QCOMPARE(memberReceiver.received[0], (MyMessage{1, "first"}));
+    QCOMPARE(memberReceiver.received[1], (MyMessage{2, "second"}));
+    QCOMPARE(Messenger::Default().DuplicatesDropped<MyMessage>(), quint64(1));
+
+    Messenger::Default().DisableDeduplication<MyMessage>();
+    Messenger::Default().Send<MyMessage>({1, "no-dedup"});
+    waitForDispatch();
+    QCOMPARE(memberReceiver.received.size(), 3);
+}
+
+void MessengerTest::dedup_window_size_and_ttl() {
+    // 窗口淘汰：超出容量的旧 ID 与过期 ID 可以再次通过
+    DedupOptions options;
+    options.windowSize = 2;
+    options.ttlMs = 50;
+    Messenger::Default().EnableDeduplication<MyMessage>([](const MyMessage& m) { return m.payload; }, options);
+    Messenger::Default().Register<MyMessage>(&memberReceiver, &TestReceiver::onMessage);
+
+    Messenger::Default().Send<MyMessage>({1, "a"});
+    Messenger::Default().Send<MyMessage>({2, "b"});
+    Messenger::Default().Send<MyMessage>({3, "c"});   // 挤出 "a"
+    Messenger::Default().Send<MyMessage>({4, "a"});   // 已不在窗口内
+    Messenger::Default().Send<MyMessage>({5, "c"});   // 仍在窗口内，丢弃
+    waitForDispatch();
+    QCOMPARE(memberReceiver.received.size(), 4);
+
+    waitForDispatch(options.ttlMs * 2);
+    Messenger::Default().Send<MyMessage>({6, "c"});   // 已过期
+    waitForDispatch();
+    QCOMPARE(memberReceiver.received.size(), 5);
+
+    Messenger::Default().DisableDeduplication<MyMessage>();
+}
+
+void MessengerTest::dump_subscriptions_json() {
+    // 订阅表导出：每个订阅一条记录，包含可读类型名、Token、接收者信息与匹配/投递计数
+    memberReceiver.setObjectName("member");
+    Messenger::Default().Register<MyMessage>(&memberReceiver, &TestReceiver::onMessage, MessageToken{"alpha"});
+    Messenger::Default().Send<MyMessage>({1, "counted"}, MessageToken{"alpha"});
+    Messenger::Default().Send<MyMessage>({2, "filtered"}, MessageToken{"beta"});
+    waitForDispatch();
+
+    const QJsonObject root = QJsonDocument::fromJson(Messenger::Default().DumpSubscriptions()).object();
+    const QJsonArray entries = root.value("subscriptions").toArray();
+    QJsonObject mine;
+    for (const auto& value : entries) {
+        const QJsonObject entry = value.toObject();
+        if (entry.value("objectName").toString() == "member") mine = entry;
+    }
+    QVERIFY(!mine.isEmpty());
+    QCOMPARE(mine.value("type").toString(), QString("MyMessage"));
+    QCOMPARE(mine.value("token").toString(), QString("alpha"));
+    QCOMPARE(mine.value("receiverClass").toString(), QString("TestReceiver"));
+    QCOMPARE(mine.value("receiverKind").toString(), QString("qobject"));
+    QCOMPARE(mine.value("dispatch").toString(), QString("auto-connection"));
+    QCOMPARE(mine.value("matched").toInt(), 1);
+    QCOMPARE(mine.value("delivered").toInt(), 1);
+    QCOMPARE(root.value("count").toInt(), entries.size());
+    memberReceiver.setObjectName(QString());
+}
+
+void MessengerTest::metrics_prometheus_text() {
+    // 指标文本：按类型+Token 聚合的计数器、累计直方图（+Inf 桶等于 count）与订阅数 gauge
+    Messenger::Default().SetLatencyTracking(true);
+    Messenger::Default().Register<MyMessage>(&memberReceiver, &TestReceiver::onMessage, MessageToken{"metrics"});
+    Messenger::Default().Send<MyMessage>({1, "a"}, MessageToken{"metrics"});
+    Messenger::Default().Send<MyMessage>({2, "b"}, MessageToken{"metrics"});
+    waitForDispatch();
+    Messenger::Default().SetLatencyTracking(false);
+
+    const QString text = QString::fromUtf8(MessengerMetricsExporter::PrometheusText());
+    QVERIFY(text.contains("# TYPE messenger_messages_delivered_total counter"));
+    QVERIFY(text.contains("messenger_messages_delivered_total{type=\"MyMessage\",token=\"metrics\"} 2\n"));
+    QVERIFY(text.contains("messenger_messages_matched_total{type=\"MyMessage\",token=\"metrics\"} 2\n"));
+    QVERIFY(text.contains("messenger_delivery_latency_seconds_bucket{type=\"MyMessage\",token=\"metrics\",le=\"+Inf\"} 2\n"));
+    QVERIFY(text.contains("messenger_delivery_latency_seconds_count{type=\"MyMessage\",token=\"metrics\"} 2\n"));
+    QVERIFY(text.contains("messenger_subscriptions{type=\"MyMessage\"}"));
+    QVERIFY(text.contains("messenger_pool_max_threads "));
+}
+
+void MessengerTest::metrics_exporter_writes_file() {
+    // 导出器：构造后立即在后台线程生成一次指标并原子写入目标文件；析构后恢复原延迟统计设置
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath("messenger.prom");
+    Messenger::Default().Register<MyMessage>(&memberReceiver, &TestReceiver::onMessage);
+    {
+        MetricsExportOptions options;
+        options.filePath = path;
+        options.intervalMs = 50;
+        QVERIFY(!Messenger::Default().LatencyTracking());
+        MessengerMetricsExporter exporter(options);
+        QVERIFY(Messenger::Default().LatencyTracking());
+        QTRY_VERIFY(QFile::exists(path));
+    }
+    QVERIFY(!Messenger::Default().LatencyTracking());
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QVERIFY(file.readAll().contains("messenger_subscriptions{type=\"MyMessage\"}"));
+}
+
+namespace {
+QList<int> hookPoints;
+void recordHook(MessengerHookPoint point, quint64, quint64) {
+    hookPoints.append(static_cast<int>(point));
+}
+}
+
+void MessengerTest::hooks_callback_policy() {
+    // 插桩：回调策略按探针点分派；未定义 MESSENGER_ENABLE_HOOKS 时宏展开为空，参数不会求值
+    hookPoints.clear();
+    MessengerCallbackHooks::SetCallback(&recordHook);
+    MessengerCallbackHooks::hook<MessengerHookPoint::HandlerBegin>(1, 2);
+    QCOMPARE(hookPoints, QList<int>{static_cast<int>(MessengerHookPoint::HandlerBegin)});
+
+    int evaluated = 0;
+    MESSENGER_HOOK(BeforeMatch, ++evaluated, 0);
+#if defined(MESSENGER_ENABLE_HOOKS)
+    QCOMPARE(evaluated, 1);
+#else
+    QCOMPARE(evaluated, 0);
+#endif
+    MessengerCallbackHooks::SetCallback(nullptr);
+}
+
+void MessengerTest::disabled_type_is_noop() {
+    // 禁用类型：Register 不进入订阅表，Send 不投递，SendWith 的工厂函数不会被调用；
+    // 优先级、类型信息与按类型注销也不会登记类型
+    static_assert(!MessageTypeEnabled<DisabledMessage>::value, "DisabledMessage should be disabled");
+    static_assert(MessageTypeEnabled<MyMessage>::value, "MyMessage should be enabled");
+
+    const int before = Messenger::Default().Stats().size();
+    int received = 0;
+    Messenger::Default().Register<DisabledMessage>(&lambdaReceiver, [&received](const DisabledMessage&) { ++received; });
+    QCOMPARE(Messenger::Default().Stats().size(), before);
+
+    int built = 0;
+    Messenger::Default().Send<DisabledMessage>({1});
+    Messenger::Default().SendWith<DisabledMessage>([&built] { ++built; return DisabledMessage{2}; });
+    waitForDispatch();
+    QCOMPARE(received, 0);
+    QCOMPARE(built, 0);
+
+    const int typesBefore = Messenger::Default().Types().size();
+    Messenger::Default().SetPriority<DisabledMessage>(MessagePriority::High);
+    QCOMPARE(Messenger::Default().Priority<DisabledMessage>(), MessagePriority::Normal);
+    Messenger::Default().Unregister<DisabledMessage>(&lambdaReceiver);
+    QCOMPARE(Messenger::Default().TypeInfo<DisabledMessage>().id, quint64(0));
+    QCOMPARE(Messenger::Default().Types().size(), typesBefore);
+
+    // 启用类型的 SendWith 与 Send 等价
+    Messenger::Default().Register<MyMessage>(&memberReceiver, &TestReceiver::onMessage);
+    Messenger::Default().SendWith<MyMessage>([&built] { ++built; return MyMessage{3, "lazy"}; });
+    waitForDispatch();
+    QCOMPARE(built, 1);
+    QCOMPARE(memberReceiver.received.size(), 1);
+    QCOMPARE(memberReceiver.received.first().payload, QString("lazy"));
+}
+
+void MessengerTest::metatype_registered_lazily() {
+    // 延迟注册：DECLARE_MESSAGE_TYPE 不再在启动时注册，首次 Register 后才能按名字查到元类型
+    QCOMPARE(QMetaType::type("LazyMessage"), int(QMetaType::UnknownType));
+
+    int received = 0;
+    Messenger::Default().Register<LazyMessage>(&lambdaReceiver, [&received](const LazyMessage& msg) { received += msg.value; });
+    QVERIFY(QMetaType::type("LazyMessage") != int(QMetaType::UnknownType));
+
+    Messenger::Default().Send<LazyMessage>({5});
+    waitForDispatch();
+    QCOMPARE(received, 5);
+    QVERIFY(Messenger::Default().DumpSubscriptions().contains("\"LazyMessage\""));
+}
+
+void MessengerTest::type_registry_info() {
+    // 类型注册表：首次使用时登记，包含名字、sizeof 与特征；未使用的类型查不到
+    QCOMPARE(Messenger::Default().TypeInfo(typeid(PodMessage).hash_code()).id, quint64(0));
+
+    const MessageTypeInfo pod = Messenger::Default().TypeInfo<PodMessage>();
+    QCOMPARE(pod.name, QByteArray("PodMessage"));
+    QCOMPARE(pod.size, int(sizeof(PodMessage)));
+    QVERIFY(pod.triviallyCopyable);
+    QVERIFY(pod.serializable);
+
+    const MessageTypeInfo my = Messenger::Default().TypeInfo<MyMessage>();
+    QCOMPARE(my.name, QByteArray("MyMessage"));
+    QVERIFY(!my.triviallyCopyable);
+    QVERIFY(!my.serializable);
+    QCOMPARE(Messenger::Default().TypeInfo(typeid(MyMessage).hash_code()).name, my.name);
+
+    const QJsonArray types = QJsonDocument::fromJson(Messenger::Default().DumpSubscriptions()).object().value("types").toArray();
+    bool found = false;
+    for (const auto& value : types) {
+        const QJsonObject entry = value.toObject();
+        if (entry.value("name").toString() == "PodMessage") {
+            found = true;
+            QCOMPARE(entry.value("size").toInt(), int(sizeof(PodMessage)));
+            QVERIFY(entry.value("serializable").toBool());
+        }
+    }
+    QVERIFY(found);
+}
+
+void MessengerTest::envelope_metadata() {
+    // 信封：同一消息的所有接收者看到相同信封；序号递增，关联 ID 默认取自身序号，可显式指定
+    QList<MessageEnvelope> lambdaEnvelopes;
+    int plainCount = 0;
+    Messenger::Default().Register<MyMessage>(&memberReceiver, &TestReceiver::onMessageWithEnvelope);
+    Messenger::Default().Register<MyMessage>(&lambdaReceiver, [&lambdaEnvelopes](const MyMessage&, const MessageEnvelope& envelope) {
+        lambdaEnvelopes.append(envelope);
+    });
+    Messenger::Default().Register<MyMessage>(&lambdaReceiver, [&plainCount](const MyMessage&) { ++plainCount; });
+
+    Messenger::Default().Send<MyMessage>({1, "first"});
+    Messenger::Default().Send<MyMessage>({2, "second"}, MessageToken(), 777);
+    waitForDispatch();
+
+    QCOMPARE(plainCount, 2);
+    QCOMPARE(memberReceiver.envelopes.size(), 2);
+    QCOMPARE(lambdaEnvelopes.size(), 2);
+    const MessageEnvelope& first = memberReceiver.envelopes.at(0);
+    const MessageEnvelope& second = memberReceiver.envelopes.at(1);
+    QCOMPARE(lambdaEnvelopes.at(0).sequence, first.sequence);
+    QVERIFY(second.sequence > first.sequence);
+    QVERIFY(first.timestampNs > 0 && second.timestampNs >= first.timestampNs);
+    QCOMPARE(first.senderThread, QThread::currentThread());
+    QCOMPARE(first.correlationId, first.sequence);
+    QCOMPARE(second.correlationId, quint64(777));
+    QCOMPARE(first.causationId, quint64(0));
+}
+
+void MessengerTest::causation_propagates_to_nested_send() {
+    // 因果传播：MyMessage 处理函数中发送的 AnotherMessage 以其 sequence 为 causationId，并继承关联 ID
+    MessageEnvelope parent;
+    MessageEnvelope child;
+    Messenger::Default().Register<MyMessage>(&lambdaReceiver, [&parent](const MyMessage&, const MessageEnvelope& envelope) {
+        parent = envelope;
+        QCOMPARE(Messenger::CurrentEnvelope()->sequence, envelope.sequence);
+        Messenger::Default().Send<AnotherMessage>({1, "follow-up"});
+    });
+    Messenger::Default().Register<AnotherMessage>(&lambdaReceiver, [&child](const AnotherMessage&, const MessageEnvelope& envelope) {
+        child = envelope;
+    });
+
+    QVERIFY(Messenger::CurrentEnvelope() == nullptr);
+    Messenger::Default().Send<MyMessage>({1, "root"}, MessageToken(), 4242);
+    waitForDispatch();
+
+    QVERIFY(parent.sequence != 0);
+    QCOMPARE(parent.causationId, quint64(0));
+    QCOMPARE(child.causationId, parent.sequence);
+    QCOMPARE(child.correlationId, quint64(4242));
+    QVERIFY(Messenger::CurrentEnvelope() == nullptr);
+}
+
+void MessengerTest::tracer_fanout_and_amplification() {
+    // 追踪：每条 MyMessage 引发 3 条 AnotherMessage，放大系数为 4（含根），树深度为 1
+    auto tracer = std::make_shared<MessageTracer>();
+    Messenger::Default().SetTracer(tracer);
+    quint64 lastRoot = 0;
+    Messenger::Default().Register<MyMessage>(&lambdaReceiver, [&lastRoot](const MyMessage&, const MessageEnvelope& envelope) {
+        lastRoot = envelope.sequence;
+        for (int i = 0; i < 3; ++i) Messenger::Default().Send<AnotherMessage>({i, "fan-out"});
+    });
+    Messenger::Default().Register<AnotherMessage>(&lambdaReceiver, [](const AnotherMessage&) {});
+
+    Messenger::Default().Send<MyMessage>({1, "a"});
+    Messenger::Default().Send<MyMessage>({2, "b"});
+    waitForDispatch();
+    Messenger::Default().SetTracer(nullptr);
+
+    const QList<TraceRecord> tree = tracer->Tree(lastRoot);
+    QCOMPARE(tree.size(), 4);
+    QCOMPARE(tree.first().typeName, QByteArray("MyMessage"));
+    QCOMPARE(tree.at(1).causationId, lastRoot);
+    QCOMPARE(tree.at(1).depth, 1);
+    QCOMPARE(tracer->RootOf(tree.last().sequence), lastRoot);
+
+    AmplificationStats mine;
+    for (const AmplificationStats& stats : tracer->Amplification()) {
+        if (stats.rootType == "MyMessage") mine = stats;
+    }
+    QCOMPARE(mine.roots, quint64(2));
+    QCOMPARE(mine.messages, quint64(8));
+    QCOMPARE(mine.factor, 4.0);
+    QCOMPARE(mine.maxDepth, 1);
+    QVERIFY(tracer->DumpTree(lastRoot).contains("children"));
+}
+
+void MessengerTest::flow_control_would_block_and_callback() {
+    // 接收者位于尚未启动的线程：排队的投递暂不执行，额度不会归还
+    QThread worker;
+    QObject receiver;
+    receiver.moveToThread(&worker);
+    std::atomic<int> received{0};
+    Messenger::Default().Register<MyMessage>(&receiver, [&received](const MyMessage&) { ++received; });
+
+    FlowControlOptions options;
+    options.credits = 2;
+    options.policy = FlowPolicy::WouldBlock;
+    Messenger::Default().EnableFlowControl(&receiver, options);
+    QCOMPARE(Messenger::Default().Send<MyMessage>({1, "a"}), SendResult::Ok);
+    QCOMPARE(Messenger::Default().Send<MyMessage>({2, "b"}), SendResult::Ok);
+    QCOMPARE(Messenger::Default().Send<MyMessage>({3, "c"}), SendResult::WouldBlock);
+    QCOMPARE(Messenger::Default().AvailableCredits(&receiver), 0);
+
+    // Callback 策略：额度耗尽时在发送线程通知生产者
+    int exhausted = 0;
+    options.policy = FlowPolicy::Callback;
+    options.credits = 1;
+    options.onExhausted = [&exhausted](quint64 type) {
+        if (type == typeid(MyMessage).hash_code()) ++exhausted;
+    };
+    Messenger::Default().EnableFlowControl(&receiver, options);
+    QCOMPARE(Messenger::Default().Send<MyMessage>({4, "d"}), SendResult::Ok);
+    QCOMPARE(Messenger::Default().Send<MyMessage>({5, "e"}), SendResult::WouldBlock);
+    QCOMPARE(exhausted, 1);
+
+    // 消费者开始处理后额度归还
+    worker.start();
+    QTRY_COMPARE(received.load(), 3);
+    QTRY_COMPARE(Messenger::Default().AvailableCredits(&receiver), 1);
+
+    Messenger::Default().Unregister(&receiver);
+    QCOMPARE(Messenger::Default().AvailableCredits(&receiver), -1);
+    worker.quit();
+    worker.wait();
+}
+
+void MessengerTest::flow_control_block_throttles_producer() {
+    // Block：额度为 1，消费者每条耗时 20ms，生产者发送 5 条被限速，且全部送达
+    QThread worker;
+    worker.start();
+    QObject receiver;
+    receiver.moveToThread(&worker);
+    std::atomic<int> received{0};
+    std::atomic<int> maxPending{0};
+    Messenger::Default().Register<MyMessage>(&receiver, [&received](const MyMessage&) {
+        QThread::msleep(20);
+        ++received;
+    });
+    FlowControlOptions options;
+    options.credits = 1;
+    Messenger::Default().EnableFlowControl(&receiver, options);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < 5; ++i) {
+        QCOMPARE(Messenger::Default().Send<MyMessage>({i, "blocking"}), SendResult::Ok);
+        for (const SubscriptionStats& stats : Messenger::Default().Stats()) {
+            if (stats.pending > quint64(maxPending.load())) maxPending = int(stats.pending);
+        }
+    }
+    QVERIFY(timer.elapsed() >= 60);  // 前 4 条各需等待上一条处理完
+    QTRY_COMPARE(received.load(), 5);
+    QVERIFY(maxPending.load() <= 1);
+
+    Messenger::Default().Unregister(&receiver);
+    worker.quit();
+    worker.wait();
+}
+
+void MessengerTest::dispatcher_coalesces_wakeups() {
+    // 目标线程忙碌期间到达的 100 条投递并入同一次唤醒；把批上限设为 10 后至少需要 10 次排空
+    QThread worker;
+    worker.setObjectName("batching-worker");
+    worker.start();
+    QObject receiver;
+    receiver.moveToThread(&worker);
+    std::atomic<int> received{0};
+    Messenger::Default().Register<MyMessage>(&receiver, [&received](const MyMessage&) { ++received; });
+
+    const auto statsOf = [&worker] {
+        const auto dispatcher = MessageDispatcher::ForThread(&worker);
+        return dispatcher->stats();
+    };
+
+    QSemaphore gate;
+    QMetaObject::invokeMethod(&receiver, [&gate] { gate.acquire(); }, Qt::QueuedConnection);
+    for (int i = 0; i < 100; ++i) Messenger::Default().Send<MyMessage>({i, "burst"});
+    QCOMPARE(statsOf().pending, quint64(100));
+    gate.release();
+    QTRY_COMPARE(received.load(), 100);
+    QCOMPARE(statsOf().wakeups, quint64(1));
+    QCOMPARE(statsOf().maxBatch, quint64(100));
+
+    const BatchingOptions previous = MessageDispatcher::Batching();
+    BatchingOptions capped;
+    capped.maxBatch = 10;
+    MessageDispatcher::SetBatchingOptions(capped);
+    QMetaObject::invokeMethod(&receiver, [&gate] { gate.acquire(); }, Qt::QueuedConnection);
+    for (int i = 0; i < 100; ++i) Messenger::Default().Send<MyMessage>({i, "capped"});
+    gate.release();
+    QTRY_COMPARE(received.load(), 200);
+    QVERIFY(statsOf().wakeups >= quint64(11));
+    MessageDispatcher::SetBatchingOptions(previous);
+
+    Messenger::Default().Unregister(&receiver);
+    worker.quit();
+    worker.wait();
+}
+
+void MessengerTest::dispatcher_priority_lanes() {
+    // 目标线程阻塞期间先发 3 条普通优先级、再发 2 条高优先级消息；恢复后高优先级先处理，各通道内保持顺序
+    QVERIFY(MessageDispatcher::WakeupEventType() >= QEvent::User);
+    QCOMPARE(MessageDispatcher::WakeupEventType(), MessageDispatcher::WakeupEventType());
+
+    QThread worker;
+    worker.setObjectName("priority-worker");
+    worker.start();
+    QObject receiver;
+    receiver.moveToThread(&worker);
+    QStringList order;  // 仅在 worker 线程写入
+    std::atomic<int> received{0};
+    Messenger::Default().Register<MyMessage>(&receiver, [&order, &received](const MyMessage& msg) {
+        order.append(QString("normal-%1").arg(msg.code));
+        ++received;
+    });
+    Messenger::Default().Register<AnotherMessage>(&receiver, [&order, &received](const AnotherMessage& msg) {
+        order.append(QString("high-%1").arg(msg.value));
+        ++received;
+    });
+    Messenger::Default().SetPriority<AnotherMessage>(MessagePriority::High);
+    QCOMPARE(Messenger::Default().Priority<AnotherMessage>(), MessagePriority::High);
+    QCOMPARE(Messenger::Default().Priority<MyMessage>(), MessagePriority::Normal);
+
+    QSemaphore gate;
+    QMetaObject::invokeMethod(&receiver, [&gate] { gate.acquire(); }, Qt::QueuedConnection);
+    for (int i = 0; i < 3; ++i) Messenger::Default().Send<MyMessage>({i, "normal"});
+    for (int i = 0; i < 2; ++i) Messenger::Default().Send<AnotherMessage>({i, "high"});
+    gate.release();
+    QTRY_COMPARE(received.load(), 5);
+    QCOMPARE(order, QStringList({"high-0", "high-1", "normal-0", "normal-1", "normal-2"}));
+
+    Messenger::Default().SetPriority<AnotherMessage>(MessagePriority::Normal);
+    QCOMPARE(Messenger::Default().Priority<AnotherMessage>(), MessagePriority::Normal);
+    Messenger::Default().Unregister(&receiver);
+    worker.quit();
+    worker.wait();
+}
+
+void MessengerTest::dispatcher_skips_finished_thread() {
+    // 线程结束后不会再发出 finished：此时若创建分发器，条目与唤醒对象永远不会被移除
+    QThread worker;
+    worker.start();
+    QObject receiver;
+    receiver.moveToThread(&worker);
+    worker.quit();
+    worker.wait();
+    QVERIFY(worker.isFinished());
+
+    const int before = MessageDispatcher::AllStats().size();
+    QVERIFY(!MessageDispatcher::ForThread(&worker));
+    int received = 0;
+    Messenger::Default().Register<MyMessage>(&receiver, [&received](const MyMessage&) { ++received; });
+    Messenger::Default().Send<MyMessage>({1, "finished"});
+    QCOMPARE(MessageDispatcher::AllStats().size(), before);
+    QCOMPARE(received, 0);
+    Messenger::Default().Unregister(&receiver);
+}
+
+void MessengerTest::dispatcher_cancels_on_thread_finish() {
+    // 目标线程没有事件循环，投递一直留在分发器队列中；线程结束时这些任务以取消模式执行：
+    // 归还占用的额度，处理函数不会被调用
+    QSemaphore finish;
+    std::unique_ptr<QThread> worker(QThread::create([&finish] { finish.acquire(); }));
+    worker->start();
+    QObject receiver;
+    receiver.moveToThread(worker.get());
+    std::atomic<int> received{0};
+    Messenger::Default().Register<MyMessage>(&receiver, [&received](const MyMessage&) { ++received; });
+    FlowControlOptions options;
+    options.credits = 2;
+    options.policy = FlowPolicy::WouldBlock;
+    Messenger::Default().EnableFlowControl(&receiver, options);
+
+    QCOMPARE(Messenger::Default().Send<MyMessage>({1, "queued"}), SendResult::Ok);
+    QCOMPARE(Messenger::Default().Send<MyMessage>({2, "queued"}), SendResult::Ok);
+    QCOMPARE(Messenger::Default().AvailableCredits(&receiver), 0);
+    QCOMPARE(Messenger::Default().Send<MyMessage>({3, "refused"}), SendResult::WouldBlock);
+
+    finish.release();
+    QVERIFY(worker->wait(5000));
+    QCOMPARE(Messenger::Default().AvailableCredits(&receiver), 2);
+    QCOMPARE(received.load(), 0);
+    Messenger::Default().DisableFlowControl(&receiver);
+    Messenger::Default().Unregister(&receiver);
+}
+
+void MessengerTest::send_staging_flushes_as_batch() {
+    // 开启暂存后 Send 不立即投递：同线程接收者在事件循环中自动刷新后收到；
+    // 1000 条跨线程消息在 Flush 时整批交给分发器，按顺序到达且只排空一次
+    Messenger::Default().Register<MyMessage>(&memberReceiver, &TestReceiver::onMessage);
+    Messenger::Default().SetSendStaging(true);
+    QVERIFY(Messenger::Default().SendStaging());
+    Messenger::Default().Send<MyMessage>({1, "staged"});
+    QCOMPARE(memberReceiver.received.size(), 0);
+    QTRY_COMPARE(memberReceiver.received.size(), 1);
+    QCOMPARE(memberReceiver.received.front().payload, QString("staged"));
+    Messenger::Default().Unregister(&memberReceiver);
+
+    QThread worker;
+    worker.setObjectName("staging-worker");
+    worker.start();
+    QObject receiver;
+    receiver.moveToThread(&worker);
+    QList<int> codes;  // 仅在 worker 线程写入
+    std::atomic<int> received{0};
+    Messenger::Default().Register<MyMessage>(&receiver, [&codes, &received](const MyMessage& msg) {
+        codes.append(msg.code);
+        ++received;
+    });
+    const auto dispatcher = MessageDispatcher::ForThread(&worker);
+    const quint64 wakeupsBefore = dispatcher->stats().wakeups;
+    const BatchingOptions previous = MessageDispatcher::Batching();
+    BatchingOptions unbounded;
+    unbounded.maxBatch = 4096;
+    unbounded.maxDrainUs = 10000000;
+    MessageDispatcher::SetBatchingOptions(unbounded);
+
+    for (int i = 0; i < 1000; ++i) Messenger::Default().Send<MyMessage>({i, "burst"});
+    QCOMPARE(dispatcher->stats().pending, quint64(0));
+    QCOMPARE(Messenger::Default().Flush(), 0);
+    QTRY_COMPARE(received.load(), 1000);
+    QCOMPARE(dispatcher->stats().wakeups - wakeupsBefore, quint64(1));
+    for (int i = 0; i < 1000; ++i) QCOMPARE(codes.at(i), i);
+    MessageDispatcher::SetBatchingOptions(previous);
+
+    Messenger::Default().SetSendStaging(false);
+    QVERIFY(!Messenger::Default().SendStaging());
+    Messenger::Default().Send<MyMessage>({1000, "direct"});
+    QTRY_COMPARE(received.load(), 1001);
+
+    Messenger::Default().Unregister(&receiver);
+    worker.quit();
+    worker.wait();
+}
+
+void MessengerTest::send_staging_flush_does_not_block() {
+    // 目标线程没有事件循环，占用的额度不会归还；Block 且不限时的流控下，
+    // Flush 只投递额度允许的一条，其余两条计入丢弃数，不会阻塞刷新线程
+    QSemaphore finish;
+    std::unique_ptr<QThread> worker(QThread::create([&finish] { finish.acquire(); }));
+    worker->start();
+    QObject receiver;
+    receiver.moveToThread(worker.get());
+    Messenger::Default().Register<MyMessage>(&receiver, [](const MyMessage&) {});
+    FlowControlOptions options;
+    options.credits = 1;
+    options.policy = FlowPolicy::Block;
+    options.blockTimeoutMs = -1;
+    Messenger::Default().EnableFlowControl(&receiver, options);
+
+    Messenger::Default().SetSendStaging(true);
+    for (int i = 0; i < 3; ++i) Messenger::Default().Send<MyMessage>({i, "staged"});
+    QCOMPARE(Messenger::Default().Flush(), 2);
+    Messenger::Default().SetSendStaging(false);
+    QCOMPARE(Messenger::Default().AvailableCredits(&receiver), 0);
+
+    finish.release();
+    QVERIFY(worker->wait(5000));
+    QCOMPARE(Messenger::Default().AvailableCredits(&receiver), 1);
+    Messenger::Default().DisableFlowControl(&receiver);
+    Messenger::Default().Unregister(&receiver);
+}
+
+void MessengerTest::publish_group_is_contiguous() {
+    // 批上限为 1 时三条普通 Send 需要三次排空，而三条消息的发布组在一次排空内连续处理；
+    // 组内共享关联 ID；额度只够两条时整组返回 WouldBlock，一条也不投递
+    QThread worker;
+    worker.setObjectName("group-worker");
+    worker.start();
+    QObject receiver;
+    receiver.moveToThread(&worker);
+    QStringList order;          // 仅在 worker 线程写入
+    QList<quint64> correlations;
+    std::atomic<int> received{0};
+    Messenger::Default().Register<MyMessage>(&receiver, [&](const MyMessage& msg, const MessageEnvelope& envelope) {
+        order.append(QString("my-%1").arg(msg.code));
+        correlations.append(envelope.correlationId);
+        ++received;
+    });
+    Messenger::Default().Register<AnotherMessage>(&receiver, [&](const AnotherMessage& msg, const MessageEnvelope& envelope) {
+        order.append(QString("another-%1").arg(msg.value));
+        correlations.append(envelope.correlationId);
+        ++received;
+    });
+    const auto dispatcher = MessageDispatcher::ForThread(&worker);
+    const BatchingOptions previous = MessageDispatcher::Batching();
+    BatchingOptions single;
+    single.maxBatch = 1;
+    MessageDispatcher::SetBatchingOptions(single);
+
+    PublishGroup group;
+    group.Add<MyMessage>({1, "a"}).Add<AnotherMessage>({2, "b"}).Add<MyMessage>({3, "c"});
+    QCOMPARE(group.size(), 3);
+    const quint64 wakeupsBefore = dispatcher->stats().wakeups;
+    QCOMPARE(Messenger::Default().Publish(group), SendResult::Ok);
+    QTRY_COMPARE(received.load(), 3);
+    QCOMPARE(order, QStringList({"my-1", "another-2", "my-3"}));
+    QCOMPARE(dispatcher->stats().wakeups - wakeupsBefore, quint64(1));
+    QCOMPARE(correlations.at(1), correlations.at(0));
+    QCOMPARE(correlations.at(2), correlations.at(0));
+    MessageDispatcher::SetBatchingOptions(previous);
+
+    FlowControlOptions options;
+    options.credits = 2;
+    options.policy = FlowPolicy::WouldBlock;
+    Messenger::Default().EnableFlowControl(&receiver, options);
+    QCOMPARE(Messenger::Default().Publish(group), SendResult::WouldBlock);
+    QCOMPARE(Messenger::Default().AvailableCredits(&receiver), 2);
+    waitForDispatch();
+    QCOMPARE(received.load(), 3);
+    Messenger::Default().DisableFlowControl(&receiver);
+
+    // Block 且不限时：整组超过额度总数时立即返回 WouldBlock，不会等待自己预留的额度；
+    // 额度够用时整组一次预留，处理完后全部归还
+    options.policy = FlowPolicy::Block;
+    options.blockTimeoutMs = -1;
+    Messenger::Default().EnableFlowControl(&receiver, options);
+    QCOMPARE(Messenger::Default().Publish(group), SendResult::WouldBlock);
+    QCOMPARE(Messenger::Default().AvailableCredits(&receiver), 2);
+    PublishGroup pair;
+    pair.Add<MyMessage>({4, "d"}).Add<MyMessage>({5, "e"});
+    QCOMPARE(Messenger::Default().Publish(pair), SendResult::Ok);
+    QTRY_COMPARE(received.load(), 5);
+    QTRY_COMPARE(Messenger::Default().AvailableCredits(&receiver), 2);
+    Messenger::Default().DisableFlowControl(&receiver);
+
+    Messenger::Default().Unregister(&receiver);
+    worker.quit();
+    worker.wait();
+}
+
+void MessengerTest::send_parallel_future() {
+    // 四个 shared_ptr 接收者在线程池中执行：三个返回 int，QFuture<int> 收集三个结果；
+    // 无返回值的处理函数同样被等待；QObject 接收者照常同步收到，不计入 QFuture
+    auto service = std::make_shared<SharedService>();
+    std::atomic<int> ran{0};
+    std::atomic<int> onSenderThread{0};
+    QThread* sender = QThread::currentThread();
+    for (int factor = 1; factor <= 3; ++factor) {
+        Messenger::Default().Register<MyMessage>(service, [&, factor](const MyMessage& msg) {
+            if (QThread::currentThread() == sender) ++onSenderThread;
+            ++ran;
+            return msg.code * factor;
+        });
+    }
+    Messenger::Default().Register<MyMessage>(service, [&](const MyMessage&) {
+        if (QThread::currentThread() == sender) ++onSenderThread;
+        ++ran;
+    });
+    Messenger::Default().Register<MyMessage>(&memberReceiver, &TestReceiver::onMessage);
+
+    QFuture<int> results = Messenger::Default().SendParallel<MyMessage, int>({7, "parallel"});
+    QCOMPARE(memberReceiver.received.size(), 1);
+    results.waitForFinished();
+    QCOMPARE(ran.load(), 4);
+    QCOMPARE(onSenderThread.load(), 0);
+    QList<int> values = results.results();
+    std::sort(values.begin(), values.end());
+    QCOMPARE(values, QList<int>({7, 14, 21}));
+
+    QFuture<void> done = Messenger::Default().SendParallel<MyMessage>({1, "void"});
+    done.waitForFinished();
+    QVERIFY(done.isFinished());
+    QCOMPARE(ran.load(), 8);
+
+    Messenger::Default().Unregister(service);
+}
+
+void MessengerTest::wide_fanout_chunks_preserve_order() {
+    // 阈值 50、每块 16：两个工作线程上的 400 个接收者连续收到 20 条消息，
+    // 分块并行排队后全部送达，且每个接收者都按 0..19 的顺序收到
+    const FanoutOptions previous = Messenger::Default().Fanout();
+    FanoutOptions options;
+    options.threshold = 50;
+    options.chunkSize = 16;
+    Messenger::Default().SetFanoutOptions(options);
+
+    QThread workers[2];
+    for (auto& worker : workers) worker.start();
+    const int N = 400;
+    const int M = 20;
+    std::vector<std::unique_ptr<TestReceiver>> receivers;
+    receivers.reserve(N);
+    for (int i = 0; i < N; ++i) {
+        auto r = std::make_unique<TestReceiver>();
+        r->moveToThread(&workers[i % 2]);
+        Messenger::Default().Register<MyMessage>(r.get(), &TestReceiver::onMessage);
+        receivers.emplace_back(std::move(r));
+    }
+    for (int i = 0; i < M; ++i) Messenger::Default().Send<MyMessage>({i, "wide"});
+
+    // 每个接收者只在所属线程写入，借助分发器排队一个屏障任务后再读取
+    for (auto& worker : workers) {
+        QSemaphore drained;
+        MessageDispatcher::ForThread(&worker)->post([&drained] { drained.release(); });
+        QVERIFY(drained.tryAcquire(1, 5000));
+    }
+    for (auto& r : receivers) {
+        QCOMPARE(r->received.size(), M);
+        for (int i = 0; i < M; ++i) QCOMPARE(r->received.at(i).code, i);
+        Messenger::Default().Unregister(r.get());
+    }
+
+    Messenger::Default().SetFanoutOptions(previous);
+    for (auto& worker : workers) {
+        worker.quit();
+        worker.wait();
+    }
+    receivers.clear();
+}
+
+void MessengerTest::handler_signatures_choose_delivery() {
+    // 右值 Send 把消息移入载荷，左值 Send 复制一次；const T& 与 shared_ptr<const T> 处理函数不再复制，
+    // shared_ptr 在发送返回后仍然有效；同步 T&& 处理函数与其他订阅者共享载荷时取走副本（复制一次），
+    // 是右值 Send 的唯一订阅者时直接移动；跨线程的唯一 T&& 订阅者在发送返回后独占载荷，同样直接移动
+    QObject owner;
+    std::shared_ptr<const CountedMessage> retained;
+    int seenByRef = 0;
+    Messenger::Default().Register<CountedMessage>(&owner, [&seenByRef](const CountedMessage& msg) { seenByRef = msg.value; });
+    Messenger::Default().Register<CountedMessage>(&owner, [&retained](std::shared_ptr<const CountedMessage> msg) { retained = std::move(msg); });
+    CountedMessage::copies = 0;
+    Messenger::Default().Send<CountedMessage>({1, "shared"});
+    QCOMPARE(CountedMessage::copies.load(), 0);
+    QCOMPARE(seenByRef, 1);
+    QVERIFY(retained);
+    QCOMPARE(retained->text, QString("shared"));
+
+    const CountedMessage lvalue(4, "lvalue");
+    CountedMessage::copies = 0;
+    Messenger::Default().Send(lvalue);
+    QCOMPARE(CountedMessage::copies.load(), 1);
+    QCOMPARE(seenByRef, 4);
+    QCOMPARE(retained->text, QString("lvalue"));
+    Messenger::Default().Unregister(&owner);
+
+    CountedMessage taken;
+    Messenger::Default().Register<CountedMessage>(&owner, [&taken](CountedMessage&& msg) { taken = std::move(msg); });
+    Messenger::Default().Register<CountedMessage>(&owner, [&seenByRef](const CountedMessage& msg) { seenByRef = msg.value; });
+    CountedMessage::copies = 0;
+    Messenger::Default().Send<CountedMessage>({2, "inline"});
+    QCOMPARE(CountedMessage::copies.load(), 1);
+    QCOMPARE(taken.text, QString("inline"));
+    QCOMPARE(seenByRef, 2);
+    Messenger::Default().Unregister(&owner);
+
+    Messenger::Default().Register<CountedMessage>(&owner, [&taken](CountedMessage&& msg) { taken = std::move(msg); });
+    CountedMessage::copies = 0;
+    Messenger::Default().Send<CountedMessage>({5, "sole"});
+    QCOMPARE(CountedMessage::copies.load(), 0);
+    QCOMPARE(taken.text, QString("sole"));
+    const CountedMessage kept(6, "kept");
+    Messenger::Default().Send(kept);
+    QCOMPARE(CountedMessage::copies.load(), 2);
+    QCOMPARE(taken.text, QString("kept"));
+    QCOMPARE(kept.text, QString("kept"));
+    Messenger::Default().Unregister(&owner);
+
+    QThread worker;
+    worker.start();
+    QObject remote;
+    remote.moveToThread(&worker);
+    std::atomic<int> received{0};
+    Messenger::Default().Register<CountedMessage>(&remote, [&taken, &received](CountedMessage&& msg) {
+        taken = std::move(msg);
+        ++received;
+    });
+    QSemaphore gate;
+    QMetaObject::invokeMethod(&remote, [&gate] { gate.acquire(); }, Qt::QueuedConnection);
+    CountedMessage::copies = 0;
+    Messenger::Default().Send<CountedMessage>({3, "moved"});
+    gate.release();
+    QTRY_COMPARE(received.load(), 1);
+    QCOMPARE(CountedMessage::copies.load(), 0);
+    QCOMPARE(taken.text, QString("moved"));
+
+    Messenger::Default().Unregister(&remote);
+    worker.quit();
+    worker.wait();
+}
+
+void MessengerTest::span_handler_receives_batches() {
+    // 目标线程阻塞期间到达的 5 条消息合并为一次调用（按发送顺序）；同线程接收者每次收到单条
+    QThread worker;
+    worker.start();
+    QObject remote;
+    remote.moveToThread(&worker);
+    QList<int> batchSizes;  // 仅在 worker 线程写入
+    QList<int> codes;
+    std::atomic<int> received{0};
+    Messenger::Default().Register<MyMessage>(&remote, [&](MessageSpan<const MyMessage> batch) {
+        batchSizes.append(int(batch.size()));
+        for (const MyMessage& msg : batch) codes.append(msg.code);
+        received += int(batch.size());
+    });
+
+    QSemaphore gate;
+    QMetaObject::invokeMethod(&remote, [&gate] { gate.acquire(); }, Qt::QueuedConnection);
+    for (int i = 0; i < 5; ++i) Messenger::Default().Send<MyMessage>({i, "batch"});
+    gate.release();
+    QTRY_COMPARE(received.load(), 5);
+    QCOMPARE(batchSizes, QList<int>({5}));
+    QCOMPARE(codes, QList<int>({0, 1, 2, 3, 4}));
+    Messenger::Default().Unregister(&remote);
+    worker.quit();
+    worker.wait();
+
+    QList<int> localSizes;
+    QObject local;
+    Messenger::Default().Register<MyMessage>(&local, [&localSizes](MessageSpan<const MyMessage> batch, const MessageEnvelope& envelope) {
+        QVERIFY(envelope.sequence != 0);
+        localSizes.append(int(batch.size()));
+    });
+    Messenger::Default().Send<MyMessage>({1, "single"});
+    Messenger::Default().Send<MyMessage>({2, "single"});
+    QCOMPARE(localSizes, QList<int>({1, 1}));
+    Messenger::Default().Unregister(&local);
+}
+
+void MessengerTest::generic_lambda_handlers() {
+    // 泛型 lambda 先匹配 const T&：函数体不会以 MessageSpan 实例化，auto 参数也不会被当作批量处理函数；
+    // 跨线程投递逐条执行
+    const auto generic = [](const auto&) {};
+    static_assert(MessengerDetail::handlerFlags<MyMessage, std::decay_t<decltype(generic)>>() == 0, "generic const auto& is a plain handler");
+    QObject owner;
+    int byRef = 0;
+    int byValue = 0;
+    Messenger::Default().Register<MyMessage>(&owner, [&byRef](const auto& msg) { byRef = msg.code; });
+    Messenger::Default().Register<MyMessage>(&owner, [&byValue](auto msg, const MessageEnvelope&) { byValue = msg.code; });
+    Messenger::Default().Send<MyMessage>({5, "generic"});
+    QCOMPARE(byRef, 5);
+    QCOMPARE(byValue, 5);
+    Messenger::Default().Unregister(&owner);
+
+    QThread worker;
+    worker.start();
+    QObject remote;
+    remote.moveToThread(&worker);
+    std::atomic<int> calls{0};
+    Messenger::Default().Register<MyMessage>(&remote, [&calls](const auto& msg) {
+        if (msg.code >= 0) ++calls;
+    });
+    QSemaphore gate;
+    QMetaObject::invokeMethod(&remote, [&gate] { gate.acquire(); }, Qt::QueuedConnection);
+    for (int i = 0; i < 3; ++i) Messenger::Default().Send<MyMessage>({i, "generic"});
+    gate.release();
+    QTRY_COMPARE(calls.load(), 3);
+    Messenger::Default().Unregister(&remote);
+    worker.quit();
+    worker.wait();
+}
+
+void MessengerTest::move_only_single_consumer() {
+    // 仅可移动的消息右值发送，只有按注册顺序第一个匹配的订阅收到，缓冲区地址不变（没有复制）；
+    // 跨线程消费者在目标线程取走消息；类型信息标记为 moveOnly 并使用声明的名字
+    QObject first;
+    QObject second;
+    std::unique_ptr<std::vector<quint8>> kept;
+    int secondCalls = 0;
+    Messenger::Default().Register<FrameMessage>(&first, [&kept](FrameMessage&& frame) { kept = std::move(frame.data); });
+    Messenger::Default().Register<FrameMessage>(&second, [&secondCalls](FrameMessage&&) { ++secondCalls; });
+    auto buffer = std::make_unique<std::vector<quint8>>(1 << 20, quint8(7));
+    std::vector<quint8>* address = buffer.get();
+    Messenger::Default().Send<FrameMessage>(FrameMessage{1, std::move(buffer)});
+    QCOMPARE(kept.get(), address);
+    QCOMPARE(secondCalls, 0);
+    Messenger::Default().Unregister(&first);
+    Messenger::Default().Unregister(&second);
+
+    QThread worker;
+    worker.start();
+    QObject remote;
+    remote.moveToThread(&worker);
+    std::unique_ptr<std::vector<quint8>> moved;  // 仅在 worker 线程写入
+    std::atomic<int> frameId{0};
+    Messenger::Default().Register<FrameMessage>(&remote, [&moved, &frameId](FrameMessage frame) {
+        moved = std::move(frame.data);
+        frameId = frame.id;
+    });
+    buffer = std::make_unique<std::vector<quint8>>(1 << 20, quint8(9));
+    address = buffer.get();
+    FrameMessage frame;
+    frame.id = 2;
+    frame.data = std::move(buffer);
+    Messenger::Default().Send<FrameMessage>(std::move(frame));
+    QTRY_COMPARE(frameId.load(), 2);
+    QCOMPARE(moved.get(), address);
+    QCOMPARE(moved->size(), size_t(1 << 20));
+
+    const MessageTypeInfo info = Messenger::Default().TypeInfo<FrameMessage>();
+    QVERIFY(info.moveOnly);
+    QCOMPARE(info.name, QByteArray("FrameMessage"));
+
+    Messenger::Default().Unregister(&remote);
+    worker.quit();
+    worker.wait();
+}
+
+void MessengerTest::small_messages_inline_payload() {
+    // 小的可平凡复制消息只在发送期间引用发送方栈上的字节：排队投递与暂存发送各自持有副本，
+    // 发送方栈帧结束后值仍正确；同步的右值处理函数拿到副本，修改不影响随后的接收者；
+    // shared_ptr 处理函数保留的消息在发送返回后仍然有效
+    static_assert(MessengerDetail::isInline<SmallMessage>(), "SmallMessage should be stored inline");
+    static_assert(!MessengerDetail::isInline<MyMessage>(), "MyMessage is not trivially copyable");
+    static_assert(!MessengerDetail::isInline<SizedMessage<512>>(), "512 bytes exceeds InlineCapacity");
+
+    QThread worker;
+    worker.start();
+    QObject remote;
+    remote.moveToThread(&worker);
+    QList<int> ids;  // 仅在 worker 线程写入
+    std::atomic<int> received{0};
+    Messenger::Default().Register<SmallMessage>(&remote, [&ids, &received](const SmallMessage& msg) {
+        ids.append(msg.id);
+        ++received;
+    });
+    QSemaphore gate;
+    QMetaObject::invokeMethod(&remote, [&gate] { gate.acquire(); }, Qt::QueuedConnection);
+    for (int i = 0; i < 100; ++i) Messenger::Default().Send<SmallMessage>({i, i * 0.5});
+    Messenger::Default().SetSendStaging(true);
+    for (int i = 100; i < 110; ++i) Messenger::Default().Send<SmallMessage>({i, i * 0.5});
+    QCOMPARE(Messenger::Default().Flush(), 0);
+    Messenger::Default().SetSendStaging(false);
+    gate.release();
+    QTRY_COMPARE(received.load(), 110);
+    QList<int> expected;
+    for (int i = 0; i < 110; ++i) expected.append(i);
+    QCOMPARE(ids, expected);
+    Messenger::Default().Unregister(&remote);
+    worker.quit();
+    worker.wait();
+
+    QObject owner;
+    int seen = -1;
+    std::shared_ptr<const SmallMessage> retained;
+    Messenger::Default().Register<SmallMessage>(&owner, [](SmallMessage&& msg) { msg.id = -1; });
+    Messenger::Default().Register<SmallMessage>(&owner, [&seen](const SmallMessage& msg) { seen = msg.id; });
+    Messenger::Default().Register<SmallMessage>(&owner, [&retained](std::shared_ptr<const SmallMessage> msg) { retained = std::move(msg); });
+    Messenger::Default().Send<SmallMessage>({7, 3.5});
+    QCOMPARE(seen, 7);
+    QVERIFY(retained);
+    QCOMPARE(retained->id, 7);
+    QCOMPARE(retained->value, 3.5);
+    Messenger::Default().Unregister(&owner);
+}
+
+namespace {
+template<int N>
+void benchmarkSend(bool crossThread) {
+    QThread worker;
+    QObject receiver;
+    if (crossThread) {
+        worker.start();
+        receiver.moveToThread(&worker);
+    }
+    QSemaphore handled;
+    quint64 sum = 0;  // 只在接收者线程写入
+    Messenger::Default().Register<SizedMessage<N>>(&receiver, [&sum, &handled, crossThread](const SizedMessage<N>& msg) {
+        sum += quint8(msg.bytes[N - 1]);
+        if (crossThread) handled.release();
+    });
+    SizedMessage<N> message{};
+    message.bytes[N - 1] = 1;
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i) Messenger::Default().Send(message);
+        // 跨线程：计时包含接收线程处理完全部 1000 条
+        if (crossThread) handled.acquire(1000);
+    }
+    Messenger::Default().Unregister(&receiver);
+    if (crossThread) {
+        worker.quit();
+        worker.wait();
+    }
+    QVERIFY(sum >= 1000);
+}
+}
+
+void MessengerTest::small_message_send_benchmark_data() {
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("crossThread");
+    QTest::newRow("8 bytes") << 8 << false;
+    QTest::newRow("64 bytes") << 64 << false;
+    QTest::newRow("512 bytes") << 512 << false;
+    QTest::newRow("8 bytes cross-thread") << 8 << true;
+    QTest::newRow("64 bytes cross-thread") << 64 << true;
+    QTest::newRow("512 bytes cross-thread") << 512 << true;
+}
+
+void MessengerTest::small_message_send_benchmark() {
+    // 每次迭代发送 1000 条。同线程：8 / 64 字节走内联路径，发送与投递不分配；
+    // 512 字节超过 InlineCapacity，每条消息经 QVariant 分配一次。
+    // 跨线程：每条排队投递仍分配任务闭包与分发器队列节点，内联只省去载荷本身的分配
+    QFETCH(int, size);
+    QFETCH(bool, crossThread);
+    switch (size) {
+    case 8: benchmarkSend<8>(crossThread); break;
+    case 64: benchmarkSend<64>(crossThread); break;
+    default: benchmarkSend<512>(crossThread); break;
+    }
+}
+
+void MessengerTest::flow_control_dropped_with_receiver() {
+    // 接收者未调用 Unregister 就析构：额度随对象移除（地址复用的新对象不会继承旧额度），
+    // Cleanup() 也不会留下失效条目
+    FlowControlOptions options;
+    options.credits = 3;
+    auto* receiver = new QObject();
+    const void* address = receiver;
+    Messenger::Default().EnableFlowControl(receiver, options);
+    QCOMPARE(Messenger::Default().AvailableCredits(receiver), 3);
+    delete receiver;
+    QCOMPARE(Messenger::Default().AvailableCredits(static_cast<QObject*>(const_cast<void*>(address))), -1);
+    Messenger::Default().Cleanup();
+
+    QObject fresh;
+    QCOMPARE(Messenger::Default().AvailableCredits(&fresh), -1);
+}
+
 QTEST_MAIN(MessengerTest)
@@ -2,7 +2,19 @@
 #include <QObject>
 #include <QString>
 #include <QList>
+#include <atomic>
+#include <memory>
+#include <vector>
 #include "../Messenger.h"
+#include "../MessageActor.h"
+#include "../MessageDispatcher.h"
+#include "../MessageExecutor.h"
+#include "../MessageJoin.h"
+#include "../MessageStrand.h"
+#include "../MessageTracer.h"
+#include "../MessengerHooks.h"
+#include "../MessengerMetrics.h"
+#include "../MessengerShards.h"
 
 // 说明：本文件定义了用于测试的消息类型和接收者类，
 // 以及测试类的各个测试槽函数声明。
@@ -29,18 +41,103 @@ struct AnotherMessage {
 };
 DECLARE_MESSAGE_TYPE(AnotherMessage)
 
+// 编译期禁用的消息类型：Register / Send 在本构建中均为空操作
+struct DisabledMessage {
+    int value = 0;
+};
+DECLARE_MESSAGE_TYPE(DisabledMessage)
+DISABLE_MESSAGE_TYPE(DisabledMessage)
+
+// 延迟注册验证专用：只在 metatype_registered_lazily 中首次使用
+struct LazyMessage {
+    int value = 0;
+};
+DECLARE_MESSAGE_TYPE(LazyMessage)
+
+// 可序列化的平凡类型：用于类型注册表的特征检测
+struct PodMessage {
+    qint32 a = 0;
+    qint32 b = 0;
+};
+inline QDataStream& operator<<(QDataStream& out, const PodMessage& m) { return out << m.a << m.b; }
+inline QDataStream& operator>>(QDataStream& in, PodMessage& m) { return in >> m.a >> m.b; }
+DECLARE_MESSAGE_TYPE(PodMessage)
+
+// 计数复制次数的消息：用于验证按处理函数签名选择的投递方式（引用 / 移动 / 共享）
+struct CountedMessage {
+    static inline std::atomic<int> copies{0};
+    int value = 0;
+    QString text;
+
+    CountedMessage() = default;
+    CountedMessage(int value, const QString& text) : value(value), text(text) {}
+    CountedMessage(const CountedMessage& other) : value(other.value), text(other.text) { ++copies; }
+    CountedMessage(CountedMessage&& other) noexcept = default;
+    CountedMessage& operator=(const CountedMessage& other) {
+        value = other.value;
+        text = other.text;
+        ++copies;
+        return *this;
+    }
+    CountedMessage& operator=(CountedMessage&& other) noexcept = default;
+};
+DECLARE_MESSAGE_TYPE(CountedMessage)
+
+// 仅可移动的消息：大缓冲区以 unique_ptr 持有，验证单消费者投递与零复制移交
+struct FrameMessage {
+    int id = 0;
+    std::unique_ptr<std::vector<quint8>> data;
+};
+DECLARE_MOVE_ONLY_MESSAGE_TYPE(FrameMessage)
+
+// 小的可平凡复制消息：走内联存储路径
+struct SmallMessage {
+    int id = 0;
+    double value = 0;
+};
+DECLARE_MESSAGE_TYPE(SmallMessage)
+
+// 基准测试用的定长消息（8 / 64 字节内联，512 字节超过 InlineCapacity）
+template<int N>
+struct SizedMessage {
+    char bytes[N];
+};
+DECLARE_MESSAGE_TYPE(SizedMessage<8>)
+DECLARE_MESSAGE_TYPE(SizedMessage<64>)
+DECLARE_MESSAGE_TYPE(SizedMessage<512>)
+
 // 接收者类型：保存收到的 MyMessage，并提供成员函数回调；
 // 同时发射 signal 以支持异步用例中的等待。
 class TestReceiver : public QObject {
     Q_OBJECT
 public:
     QList<MyMessage> received;
+    QList<MessageEnvelope> envelopes;
 
     void onMessage(const MyMessage& msg);
+    void onMessageWithEnvelope(const MyMessage& msg, const MessageEnvelope& envelope);
 signals:
     void messageReceived();
 };
 
+// Actor 接收者：非 QObject，记录收到的消息并检测回调是否并发执行
+class CountingActor : public MessageActor {
+public:
+    QList<int> codes;
+    std::atomic<int> count{0};
+    std::atomic<int> inHandler{0};
+    std::atomic<bool> overlapped{false};
+
+    ~CountingActor() override { close(); }
+    void onMessage(const MyMessage& msg);
+};
+
+// 非 QObject 服务：由 shared_ptr 管理，以 weak_ptr 订阅
+struct SharedService {
+    QList<MyMessage> received;
+    void onMessage(const MyMessage& msg) { received.append(msg); }
+};
+
 // 测试类：包含所有针对 Messenger 的测试用例
 class MessengerTest : public QObject {
     Q_OBJECT
@@ -75,4 +172,46 @@ private slots:
     void send_then_immediate_unregister_race_cross_thread(); // 跨线程发送后立即注销的竞态
     void multi_type_concurrent();                 // 多消息类型并发交织
     void broadcast_many_receivers();              // 大量接收者广播一次消息
+    void join_pairs_by_key();                     // 两种类型按键关联，双侧到达后组合投递
+    void join_bounded_by_capacity_and_ttl();      // 未匹配条目受容量与 TTL 约束
+    void shards_local_and_cross_shard_delivery(); // 分片总线：本地直投、跨分片与外部线程经邮箱投递
+    void actor_receives_in_order();               // Actor 通过同一 Register 接口订阅，按序接收
+    void actor_handlers_never_overlap();          // 多线程发送时 Actor 回调互不并发
+    void actor_close_waits_and_drops();           // Actor close()：等待执行中的回调，丢弃排队任务与之后的投递
+    void weak_ptr_receiver_lifetime();            // weak_ptr 接收者：投递时 lock，释放后不再投递
+    void weak_ptr_receiver_unregister();          // shared_ptr 接收者按对象 / 类型 / Token 注销
+    void executor_routes_to_pool_and_thread();    // 执行器：回调运行在线程池 / 指定线程
+    void executor_custom_and_receiverless();      // 自定义执行器与无接收者订阅、按执行器注销
+    void strand_serializes_handlers();            // 同一 Strand 上的多个订阅互不并发、按序执行
+    void dedup_drops_repeated_ids();              // 去重：窗口内相同 ID 只扇出一次
+    void dedup_window_size_and_ttl();             // 去重窗口按数量与 TTL 淘汰
+    void dump_subscriptions_json();               // 订阅表 JSON 导出：类型名、Token、接收者与计数器
+    void metrics_prometheus_text();               // Prometheus 文本：计数器、延迟直方图与订阅数
+    void metrics_exporter_writes_file();          // 导出器在后台线程原子写入指标文件
+    void hooks_callback_policy();                 // 插桩 Hook：回调策略分派；未启用时宏不求值参数
+    void disabled_type_is_noop();                 // 编译期禁用类型：不注册、不投递、SendWith 不构造参数
+    void metatype_registered_lazily();            // 元类型在首次 Register/Send 时注册，而非静态初始化
+    void type_registry_info();                    // 类型注册表：名字、sizeof、平凡复制与可序列化标记
+    void envelope_metadata();                     // 信封：序号、时间戳、发送线程与关联 ID，可选第二参数接收
+    void causation_propagates_to_nested_send();   // 处理函数内的 Send 自动继承因果与关联 ID
+    void tracer_fanout_and_amplification();       // 追踪器还原扇出树并按根类型统计放大系数
+    void flow_control_would_block_and_callback(); // 流控：额度耗尽返回 WouldBlock / 回调生产者，处理后归还额度
+    void flow_control_block_throttles_producer(); // 流控 Block：生产者被限速到消费者速度，队列不超过额度
+    void flow_control_dropped_with_receiver();    // 流控：接收者未注销就析构时额度随之移除
+    void dispatcher_coalesces_wakeups();          // 跨线程投递并入已有唤醒；批大小受上限约束
+    void dispatcher_priority_lanes();             // 自定义唤醒事件；高优先级类型在同一次排空中先于普通投递处理
+    void dispatcher_skips_finished_thread();      // 已结束线程不创建分发器，投递直接丢弃
+    void dispatcher_cancels_on_thread_finish();   // 线程结束时未执行的投递以取消模式归还流控额度，处理函数不执行
+    void send_staging_flushes_as_batch();         // 发送暂存：事件循环本轮结束或 Flush 时整批发送，跨线程只唤醒一次
+    void send_staging_flush_does_not_block();     // 刷新暂存区时 Block 策略按 WouldBlock 处理，额度不足的消息计入丢弃数
+    void publish_group_is_contiguous();           // 发布组：一次排空内连续处理、共享关联 ID，流控全有或全无
+    void send_parallel_future();                  // 并行发送：线程无关处理函数在线程池执行，QFuture 汇总结果
+    void wide_fanout_chunks_preserve_order();     // 大扇出分块并行排队：全部送达，每个接收者顺序不变
+    void handler_signatures_choose_delivery();    // 处理函数签名：const T& 不复制、shared_ptr 共享载荷、T&& 独占时移动
+    void span_handler_receives_batches();         // MessageSpan 处理函数：跨线程投递在订阅内合批，同步投递为单条
+    void generic_lambda_handlers();               // 泛型 lambda（const auto& / auto）按 const T& 投递，不被识别为批量处理函数
+    void move_only_single_consumer();             // 仅可移动的消息：只投递给第一个匹配的订阅，缓冲区原样移交
+    void small_messages_inline_payload();         // 小消息内联存储：排队、暂存后值正确，右值处理函数不影响其他接收者
+    void small_message_send_benchmark_data();
+    void small_message_send_benchmark();          // 基准：8 / 64 / 512 字节消息的同线程与跨线程发送
 };